@@ -0,0 +1,172 @@
+// Нагрузочный тест журнала действий игроков.
+// Клиенты входят в игру по одному запросу за раз и ждут подтверждения записи, как
+// обработчики HTTP. Для каждого сочетания --journal-commit-batch и --journal-commit-interval
+// выводятся пропускная способность и задержка подтверждения
+#include <boost/program_options.hpp>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "journal.h"
+
+using namespace std::literals;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Args {
+    unsigned clients = 64;
+    unsigned records = 200;
+    std::vector<unsigned> commit_batches{1, 16, 256};
+    std::vector<unsigned> commit_intervals{0, 1, 5};
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+};
+
+// Создаёт новый подкаталог в dir. Удалять после теста можно только его:
+// dir задаёт пользователь, и в нём могут быть чужие файлы
+std::filesystem::path MakeWorkDir(const std::filesystem::path& dir) {
+    const auto work_dir = dir / ("journal_bench."s + std::to_string(::getpid()));
+    std::filesystem::create_directories(dir);
+    if (!std::filesystem::create_directory(work_dir)) {
+        throw std::runtime_error(work_dir.string() + " already exists");
+    }
+    return work_dir;
+}
+
+// Ожидание подтверждения одной записи
+class CommitWaiter {
+public:
+    void Commit(bool committed) {
+        {
+            std::lock_guard lock{mutex_};
+            committed_ = committed;
+        }
+        cv_.notify_one();
+    }
+
+    bool Wait() {
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this] {
+            return committed_.has_value();
+        });
+        return *std::exchange(committed_, std::nullopt);
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::optional<bool> committed_;
+};
+
+void Run(const Args& args, unsigned commit_batch, unsigned commit_interval) {
+    const auto work_dir = MakeWorkDir(args.dir);
+
+    std::vector<std::vector<Clock::duration>> latencies(args.clients);
+    std::atomic<std::uint64_t> failed{0};
+    Clock::duration elapsed{};
+    {
+        persistence::Journal journal{work_dir / "journal", std::chrono::milliseconds{commit_interval}, commit_batch};
+        const model::Map::Id map_id{model::IdString{"map1"sv}};
+
+        const auto started_at = Clock::now();
+        std::vector<std::jthread> clients;
+        for (unsigned c = 0; c < args.clients; ++c) {
+            clients.emplace_back([&, c] {
+                CommitWaiter waiter;
+                auto& client_latencies = latencies[c];
+                client_latencies.reserve(args.records);
+                for (unsigned i = 0; i < args.records; ++i) {
+                    const std::uint64_t id = static_cast<std::uint64_t>(c) * args.records + i;
+                    const app::PlayerState player{app::Player::Id{id}, app::GenerateToken(), "dog"s, map_id, {0, 0}};
+                    const auto enqueued_at = Clock::now();
+                    journal.OnJoinGame(player, [&waiter](bool committed) {
+                        waiter.Commit(committed);
+                    });
+                    if (!waiter.Wait()) {
+                        ++failed;
+                    }
+                    client_latencies.push_back(Clock::now() - enqueued_at);
+                }
+            });
+        }
+        clients.clear();
+        elapsed = Clock::now() - started_at;
+    }
+    std::filesystem::remove_all(work_dir);
+
+    std::vector<Clock::duration> all;
+    for (const auto& client_latencies : latencies) {
+        all.insert(all.end(), client_latencies.begin(), client_latencies.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile_us = [&all](double p) {
+        const auto index = std::min(all.size() - 1, static_cast<size_t>(p * static_cast<double>(all.size())));
+        return std::chrono::duration<double, std::micro>(all[index]).count();
+    };
+
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << "commit_batch="sv << commit_batch << " commit_interval_ms="sv << commit_interval
+              << " records="sv << all.size() << " failed="sv << failed
+              << " records_per_s="sv << static_cast<double>(all.size()) / seconds
+              << " p50_us="sv << percentile_us(0.5) << " p99_us="sv << percentile_us(0.99)
+              << " max_us="sv << percentile_us(1.0) << std::endl;
+}
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    Args args;
+    po::options_description desc{"Allowed options"s};
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("clients", po::value(&args.clients)->value_name("n"s), "number of concurrent clients")
+        ("records", po::value(&args.records)->value_name("n"s), "number of records per client")
+        ("journal-commit-batch", po::value(&args.commit_batches)->multitoken()->value_name("records"s),
+         "list of max group commit sizes to try")
+        ("journal-commit-interval", po::value(&args.commit_intervals)->multitoken()->value_name("milliseconds"s),
+         "list of max group commit delays to try")
+        ("dir", po::value(&args.dir)->value_name("dir"s),
+         "directory to create a temporary subdirectory for journal segments in (system temp directory by default)");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if (args.clients == 0 || args.records == 0) {
+        throw std::runtime_error("--clients and --records must be positive");
+    }
+    return args;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    try {
+        const auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+        for (const unsigned commit_batch : args->commit_batches) {
+            for (const unsigned commit_interval : args->commit_intervals) {
+                Run(*args, commit_batch, commit_interval);
+            }
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,93 @@
+// Сравнение двоичного представления карты с JSON: размер ответа и стоимость сериализации.
+// Карты берутся из конфигурационного файла игры
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include "json_loader.h"
+#include "map_responses.h"
+
+using namespace std::literals;
+
+namespace {
+
+struct Args {
+    std::string config_file;
+    unsigned iterations = 10'000;
+};
+
+// Возвращает среднее время одной сериализации в микросекундах
+template <typename Serialize>
+double MeasureEncode(const model::Map& map, unsigned iterations, Serialize serialize) {
+    size_t total_size = 0;
+    const auto started_at = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        // Суммарный размер не даёт компилятору выбросить сериализацию
+        total_size += serialize(map).size();
+    }
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - started_at;
+    if (total_size == 0) {
+        std::cerr << "empty output"sv << std::endl;
+    }
+    return elapsed.count() / iterations;
+}
+
+void Run(const Args& args) {
+    const model::Game game = json_loader::LoadGame(args.config_file);
+    for (const auto& map : game.GetMaps()) {
+        const size_t json_size = http_handler::SerializeMapJson(map).size();
+        const size_t binary_size = http_handler::SerializeMapBinary(map).size();
+        const double json_us = MeasureEncode(map, args.iterations, http_handler::SerializeMapJson);
+        const double binary_us = MeasureEncode(map, args.iterations, http_handler::SerializeMapBinary);
+
+        std::cout << "map="sv << (*map.GetId()).View() << " roads="sv << map.GetRoads().size()
+                  << " buildings="sv << map.GetBuildings().size() << " offices="sv << map.GetOffices().size()
+                  << " json_bytes="sv << json_size << " binary_bytes="sv << binary_size
+                  << " size_ratio="sv << static_cast<double>(binary_size) / static_cast<double>(json_size)
+                  << " json_encode_us="sv << json_us << " binary_encode_us="sv << binary_us << std::endl;
+    }
+}
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    Args args;
+    po::options_description desc{"Allowed options"s};
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("config-file,c", po::value(&args.config_file)->value_name("file"s), "set config file path")
+        ("iterations", po::value(&args.iterations)->value_name("n"s), "number of serializations per map");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if (!vm.contains("config-file"s)) {
+        throw std::runtime_error("Config file has not been specified");
+    }
+    if (args.iterations == 0) {
+        throw std::runtime_error("--iterations must be positive");
+    }
+    return args;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    try {
+        const auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+        Run(*args);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
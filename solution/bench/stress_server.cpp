@@ -0,0 +1,459 @@
+// Стресс-тест сервера: клиенты из нескольких потоков отправляют вперемешку корректные
+// и некорректные запросы серверу, запущенному в этом же процессе на loopback.
+// Проверяет, что на каждый запрос приходит ожидаемый ответ, сервер не зависает,
+// после теста отвечает на запросы и не держит закрытые клиентами сессии.
+// Удобно запускать в сборке с -DGAME_SERVER_SANITIZE=address,undefined или thread
+#include "sdk.h"
+//
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/json.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application.h"
+#include "http_server.h"
+#include "json_loader.h"
+#include "request_handler.h"
+#include "state_broadcaster.h"
+#include "tracing.h"
+
+using namespace std::literals;
+
+namespace {
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace json = boost::json;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+struct Args {
+    std::string config_file;
+    unsigned clients = 16;
+    unsigned requests = 2000;
+    unsigned server_threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned short port = 0;
+    unsigned trace_sample_every = 0;
+    unsigned timeout = 60;
+};
+
+// Ответ, которого ждёт клиент: код статуса или закрытие соединения сервером
+constexpr unsigned CLOSED = 0;
+
+struct ClientState {
+    std::string map_id;
+    std::optional<std::string> token;
+};
+
+struct Case {
+    std::string_view name;
+    // Байты, отправляемые серверу
+    std::function<std::string(const ClientState&)> make_request;
+    // Ожидаемый ответ
+    std::function<unsigned(const ClientState&)> expected;
+    // Запрос отправляется в отдельном соединении, так как после него сервер закрывает соединение
+    bool own_connection = false;
+    // Соединение закрывается клиентом на запись после отправки запроса
+    bool shutdown_send = false;
+};
+
+std::string Request(std::string_view method, std::string_view target, std::string_view headers = {},
+                    std::string_view body = {}) {
+    std::string request;
+    request.append(method).append(" "sv).append(target).append(" HTTP/1.1\r\nHost: 127.0.0.1\r\n"sv);
+    request.append(headers);
+    if (!body.empty() || method == "POST"sv) {
+        request.append("Content-Type: application/json\r\nContent-Length: "sv)
+            .append(std::to_string(body.size()))
+            .append("\r\n"sv);
+    }
+    request.append("\r\n"sv).append(body);
+    return request;
+}
+
+std::string Bearer(std::string_view token) {
+    return "Authorization: Bearer "s + std::string{token} + "\r\n"s;
+}
+
+auto Status(unsigned status) {
+    return [status](const ClientState&) {
+        return status;
+    };
+}
+
+std::vector<Case> MakeCases() {
+    std::vector<Case> cases;
+    auto add = [&cases](Case c) {
+        cases.push_back(std::move(c));
+    };
+
+    // Корректные запросы
+    add({"maps"sv, [](const ClientState&) { return Request("GET"sv, "/api/v1/maps"sv); }, Status(200)});
+    add({"map"sv, [](const ClientState& s) { return Request("GET"sv, "/api/v1/maps/"s + s.map_id); },
+         Status(200)});
+    add({"map_binary"sv,
+         [](const ClientState& s) {
+             return Request("GET"sv, "/api/v1/maps/"s + s.map_id + "?v=1"s,
+                            "Accept: application/x-game-map, application/json;q=0.5\r\n"sv);
+         },
+         Status(200)});
+    add({"join"sv,
+         [](const ClientState& s) {
+             return Request("POST"sv, "/api/v1/game/join"sv, {},
+                            R"({"userName": "stress", "mapId": ")"s + s.map_id + R"("})"s);
+         },
+         Status(200)});
+    add({"players"sv,
+         [](const ClientState& s) {
+             return Request("GET"sv, "/api/v1/game/players"sv, s.token ? Bearer(*s.token) : ""s);
+         },
+         [](const ClientState& s) {
+             return s.token ? 200u : 401u;
+         }});
+
+    // Некорректные запросы, на которые сервер отвечает ошибкой и продолжает работу с соединением
+    add({"map_not_found"sv, [](const ClientState&) { return Request("GET"sv, "/api/v1/maps/nope"sv); },
+         Status(404)});
+    add({"map_id_too_long"sv,
+         [](const ClientState&) { return Request("GET"sv, "/api/v1/maps/"s + std::string(300, 'x')); },
+         Status(404)});
+    add({"path_traversal"sv,
+         [](const ClientState&) { return Request("GET"sv, "/api/v1/maps/../../../etc/passwd"sv); },
+         Status(404)});
+    add({"maps_bad_method"sv, [](const ClientState&) { return Request("DELETE"sv, "/api/v1/maps"sv); },
+         Status(405)});
+    add({"join_bad_method"sv, [](const ClientState&) { return Request("GET"sv, "/api/v1/game/join"sv); },
+         Status(405)});
+    add({"join_bad_json"sv,
+         [](const ClientState&) { return Request("POST"sv, "/api/v1/game/join"sv, {}, R"({"userName": )"sv); },
+         Status(400)});
+    add({"join_wrong_types"sv,
+         [](const ClientState&) {
+             return Request("POST"sv, "/api/v1/game/join"sv, {}, R"({"userName": 1, "mapId": [true]})"sv);
+         },
+         Status(400)});
+    add({"join_unknown_map"sv,
+         [](const ClientState&) {
+             return Request("POST"sv, "/api/v1/game/join"sv, {}, R"({"userName": "stress", "mapId": "nope"})"sv);
+         },
+         Status(404)});
+    add({"players_no_token"sv, [](const ClientState&) { return Request("GET"sv, "/api/v1/game/players"sv); },
+         Status(401)});
+    add({"players_bad_token"sv,
+         [](const ClientState&) {
+             return Request("GET"sv, "/api/v1/game/players"sv, Bearer(std::string(32, '0')));
+         },
+         Status(401)});
+    add({"players_malformed_token"sv,
+         [](const ClientState&) {
+             return Request("GET"sv, "/api/v1/game/players"sv, "Authorization: Bearer zz\r\n"sv);
+         },
+         Status(401)});
+    add({"state_without_upgrade"sv,
+         [](const ClientState&) { return Request("GET"sv, "/api/v1/game/state"sv); }, Status(400)});
+    add({"unknown_api"sv, [](const ClientState&) { return Request("GET"sv, "/api/v2/unknown"sv); },
+         Status(400)});
+    // Служебные эндпоинты не обслуживаются листенерами игроков, даже если трассировка включена
+    add({"admin_on_public_listener"sv,
+         [](const ClientState&) {
+             return Request("POST"sv, "/api/v1/admin/trace"sv, {}, R"({"sampleEvery": 1})"sv);
+         },
+         Status(400)});
+    add({"not_api"sv, [](const ClientState&) { return Request("GET"sv, "/index.html"sv); }, Status(404)});
+
+    // Запросы, которые нельзя разобрать: сервер закрывает соединение
+    add({"garbage"sv, [](const ClientState&) { return "\x01\x02\xff\xfe GARBAGE\r\n\r\n"s; }, Status(CLOSED),
+         true});
+    add({"bad_version"sv, [](const ClientState&) { return "GET /api/v1/maps HTTP/9.9\r\n\r\n"s; },
+         Status(CLOSED), true});
+    add({"oversized_header"sv,
+         [](const ClientState&) {
+             return Request("GET"sv, "/api/v1/maps"sv, "X-Padding: "s + std::string(16 * 1024, 'a') + "\r\n"s);
+         },
+         Status(CLOSED), true});
+    add({"oversized_body"sv,
+         [](const ClientState&) {
+             return "POST /api/v1/game/join HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 100000000000\r\n\r\n{"s;
+         },
+         Status(CLOSED), true});
+    add({"bad_content_length"sv,
+         [](const ClientState&) {
+             return "POST /api/v1/game/join HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: -1\r\n\r\n"s;
+         },
+         Status(CLOSED), true});
+    add({"truncated"sv,
+         [](const ClientState&) { return "GET /api/v1/maps HTTP/1.1\r\nHost: 127.0.0.1\r\n"s; }, Status(CLOSED),
+         true, true});
+    return cases;
+}
+
+struct CaseStats {
+    std::atomic<std::uint64_t> sent{0};
+    std::atomic<std::uint64_t> unexpected{0};
+};
+
+// Отправляет запрос и возвращает код статуса ответа или CLOSED, если сервер закрыл соединение
+unsigned Exchange(tcp::socket& socket, beast::flat_buffer& buffer, const std::string& request, bool shutdown_send,
+                  http::response<http::string_body>& response) {
+    auto is_closed = [](const beast::error_code& ec) {
+        return ec == http::error::end_of_stream || ec == net::error::eof || ec == net::error::connection_reset
+            || ec == net::error::broken_pipe;
+    };
+
+    // Сервер может закрыть соединение, не дочитав длинный некорректный запрос
+    beast::error_code ec;
+    net::write(socket, net::buffer(request), ec);
+    if (!ec && shutdown_send) {
+        socket.shutdown(tcp::socket::shutdown_send, ec);
+    }
+    if (is_closed(ec)) {
+        return CLOSED;
+    }
+    if (ec) {
+        throw beast::system_error{ec};
+    }
+    http::response_parser<http::string_body> parser;
+    parser.body_limit(16 * 1024 * 1024);
+    http::read(socket, buffer, parser, ec);
+    if (is_closed(ec)) {
+        return CLOSED;
+    }
+    if (ec) {
+        throw beast::system_error{ec};
+    }
+    response = parser.release();
+    return response.result_int();
+}
+
+void RunClient(const tcp::endpoint& endpoint, const std::vector<Case>& cases, std::vector<CaseStats>& stats,
+               const std::string& map_id, unsigned client_index, unsigned requests, std::atomic<std::uint64_t>& errors) {
+    net::io_context ioc;
+    ClientState state{map_id, std::nullopt};
+    std::optional<tcp::socket> connection;
+    beast::flat_buffer connection_buffer;
+
+    for (unsigned i = 0; i < requests; ++i) {
+        // Клиенты начинают с разных запросов, чтобы в каждый момент сервер получал разные запросы
+        const size_t case_index = (static_cast<size_t>(client_index) * 7 + i) % cases.size();
+        const Case& c = cases[case_index];
+        try {
+            std::optional<tcp::socket> own_socket;
+            beast::flat_buffer own_buffer;
+            if (!c.own_connection && !connection) {
+                connection.emplace(ioc);
+                connection->connect(endpoint);
+                connection_buffer.clear();
+            }
+            if (c.own_connection) {
+                own_socket.emplace(ioc);
+                own_socket->connect(endpoint);
+            }
+            tcp::socket& socket = c.own_connection ? *own_socket : *connection;
+            beast::flat_buffer& buffer = c.own_connection ? own_buffer : connection_buffer;
+
+            const unsigned expected = c.expected(state);
+            http::response<http::string_body> response;
+            const unsigned status = Exchange(socket, buffer, c.make_request(state), c.shutdown_send, response);
+            ++stats[case_index].sent;
+            if (status != expected) {
+                ++stats[case_index].unexpected;
+            }
+            if (status == CLOSED || !response.keep_alive()) {
+                if (!c.own_connection) {
+                    connection.reset();
+                }
+            }
+            if (c.name == "join"sv && status == 200) {
+                state.token = json::value_to<std::string>(json::parse(response.body()).as_object().at("authToken"));
+            }
+        } catch (const std::exception& ex) {
+            ++errors;
+            connection.reset();
+            std::cerr << "client "sv << client_index << ", "sv << c.name << ": "sv << ex.what() << std::endl;
+        }
+    }
+}
+
+tcp::endpoint MakeEndpoint(unsigned short port) {
+    const auto address = net::ip::make_address("127.0.0.1"sv);
+    if (port != 0) {
+        return {address, port};
+    }
+    // ServeHttp не сообщает выбранный системой порт, поэтому занимаем свободный порт и сразу отпускаем
+    net::io_context ioc;
+    tcp::acceptor acceptor{ioc, {address, 0}};
+    return acceptor.local_endpoint();
+}
+
+bool Run(const Args& args) {
+    model::Game game = json_loader::LoadGame(args.config_file);
+    if (game.GetMaps().empty()) {
+        throw std::runtime_error("Config has no maps");
+    }
+    const std::string map_id{(*game.GetMaps().front().GetId()).View()};
+
+    // Сервер
+    http_server::ConnectionTracker tracker;
+    net::io_context ioc(static_cast<int>(args.server_threads));
+    app::Application application{game, ioc};
+    http_handler::StateBroadcaster broadcaster{application};
+    http_handler::RequestHandler handler{game, application, broadcaster};
+    tracing::Tracer tracer{args.trace_sample_every};
+    handler.SetTracer(&tracer);
+
+    const auto endpoint = MakeEndpoint(args.port);
+    http_server::ServeHttp(ioc, endpoint, [&handler](auto&& req, auto&& send, auto&& accept_websocket) {
+        handler(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send),
+                std::forward<decltype(accept_websocket)>(accept_websocket));
+    }, http_server::SessionServices{nullptr, &tracker, &tracer});
+    auto work = net::make_work_guard(ioc);
+    std::vector<std::jthread> server_threads;
+    for (unsigned i = 0; i < args.server_threads; ++i) {
+        server_threads.emplace_back([&ioc] {
+            ioc.run();
+        });
+    }
+    std::cout << "Listening on "sv << endpoint << std::endl;
+
+    // Клиенты. Если сервер перестал отвечать, клиенты зависнут в чтении, и тест завершится по таймауту
+    const auto cases = MakeCases();
+    std::vector<CaseStats> stats(cases.size());
+    std::atomic<std::uint64_t> errors{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    unsigned finished_clients = 0;
+
+    const auto started_at = Clock::now();
+    std::vector<std::jthread> clients;
+    for (unsigned c = 0; c < args.clients; ++c) {
+        clients.emplace_back([&, c] {
+            RunClient(endpoint, cases, stats, map_id, c, args.requests, errors);
+            {
+                std::lock_guard lock{mutex};
+                ++finished_clients;
+            }
+            cv.notify_one();
+        });
+    }
+    {
+        std::unique_lock lock{mutex};
+        if (!cv.wait_for(lock, std::chrono::seconds{args.timeout}, [&] {
+                return finished_clients == args.clients;
+            })) {
+            std::cout << "FAILED: server has not answered in "sv << args.timeout << " s, clients finished: "sv
+                      << finished_clients << '/' << args.clients << std::endl;
+            std::_Exit(EXIT_FAILURE);
+        }
+    }
+    clients.clear();
+    const double seconds = std::chrono::duration<double>(Clock::now() - started_at).count();
+
+    bool ok = errors == 0;
+    std::uint64_t total = 0;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        total += stats[i].sent;
+        ok = ok && stats[i].unexpected == 0;
+        std::cout << "case="sv << cases[i].name << " sent="sv << stats[i].sent << " unexpected="sv
+                  << stats[i].unexpected << std::endl;
+    }
+    std::cout << "requests="sv << total << " errors="sv << errors << " requests_per_s="sv
+              << static_cast<double>(total) / seconds << std::endl;
+
+    // Сервер продолжает отвечать после некорректных запросов
+    {
+        net::io_context client_ioc;
+        tcp::socket socket{client_ioc};
+        socket.connect(endpoint);
+        beast::flat_buffer buffer;
+        http::response<http::string_body> response;
+        const unsigned status =
+            Exchange(socket, buffer, Request("GET"sv, "/api/v1/maps"sv), false, response);
+        const bool alive = status == 200;
+        std::cout << "alive="sv << alive << std::endl;
+        ok = ok && alive;
+    }
+
+    // Все соединения закрыты клиентами, сессии не должны оставаться в учёте
+    const auto deadline = Clock::now() + 2s;
+    while (tracker.GetActiveSessions() != 0 && Clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    std::cout << "active_sessions="sv << tracker.GetActiveSessions() << " in_flight_requests="sv
+              << tracker.GetInFlightRequests() << std::endl;
+    ok = ok && tracker.GetActiveSessions() == 0 && tracker.GetInFlightRequests() == 0;
+
+    tracker.StartDrain();
+    work.reset();
+    ioc.stop();
+    server_threads.clear();
+
+    std::cout << (ok ? "PASSED"sv : "FAILED"sv) << std::endl;
+    return ok;
+}
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    Args args;
+    po::options_description desc{"Allowed options"s};
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("config-file,c", po::value(&args.config_file)->value_name("file"s), "set config file path")
+        ("clients", po::value(&args.clients)->value_name("n"s), "number of client threads")
+        ("requests", po::value(&args.requests)->value_name("n"s), "number of requests per client")
+        ("server-threads", po::value(&args.server_threads)->value_name("n"s), "number of server worker threads")
+        ("port", po::value(&args.port)->value_name("port"s), "loopback port to listen on (any free port by default)")
+        ("trace-sample-every", po::value(&args.trace_sample_every)->value_name("requests"s),
+         "trace every N-th request (0 by default)")
+        ("timeout", po::value(&args.timeout)->value_name("seconds"s),
+         "fail if clients have not finished in time (60 by default)");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if (!vm.contains("config-file"s)) {
+        throw std::runtime_error("Config file has not been specified");
+    }
+    if (args.clients == 0 || args.requests == 0 || args.server_threads == 0) {
+        throw std::runtime_error("--clients, --requests and --server-threads must be positive");
+    }
+    return args;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    try {
+        const auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+        return Run(*args) ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
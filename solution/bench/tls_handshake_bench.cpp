@@ -0,0 +1,341 @@
+// Нагрузочный тест TLS-рукопожатий сервера.
+// Создаёт самоподписанный сертификат, запускает сервер с контекстом MakeServerSslContext
+// на loopback и измеряет:
+//  - число полных рукопожатий в секунду из нескольких потоков;
+//  - задержку полного рукопожатия и рукопожатия с возобновлением сессии по session id (TLS 1.2)
+//    и по session ticket (TLS 1.2 и TLS 1.3).
+// Завершается с ошибкой, если сервер не возобновил ни одной сессии каким-либо из способов
+#include <boost/program_options.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "http_server.h"
+
+using namespace std::literals;
+
+namespace {
+
+namespace net = http_server::net;
+namespace ssl = http_server::ssl;
+namespace beast = http_server::beast;
+namespace http = http_server::http;
+using tcp = http_server::tcp;
+using Clock = std::chrono::steady_clock;
+
+struct Args {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned server_threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned handshakes = 2000;
+    unsigned resumptions = 500;
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+};
+
+template <typename T, void (*Free)(T*)>
+struct OpenSslDeleter {
+    void operator()(T* ptr) const noexcept {
+        Free(ptr);
+    }
+};
+
+using PKeyPtr = std::unique_ptr<EVP_PKEY, OpenSslDeleter<EVP_PKEY, EVP_PKEY_free>>;
+using PKeyCtxPtr = std::unique_ptr<EVP_PKEY_CTX, OpenSslDeleter<EVP_PKEY_CTX, EVP_PKEY_CTX_free>>;
+using X509Ptr = std::unique_ptr<X509, OpenSslDeleter<X509, X509_free>>;
+using SessionPtr = std::unique_ptr<SSL_SESSION, OpenSslDeleter<SSL_SESSION, SSL_SESSION_free>>;
+
+void CheckOpenSsl(bool ok, const char* what) {
+    if (!ok) {
+        throw std::runtime_error("OpenSSL: "s + what + " failed");
+    }
+}
+
+// Создаёт ключ P-256 и самоподписанный сертификат для localhost и записывает их в PEM-файлы
+void WriteSelfSignedCertificate(const std::filesystem::path& cert_file, const std::filesystem::path& key_file) {
+    PKeyCtxPtr key_ctx{EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr)};
+    CheckOpenSsl(key_ctx && EVP_PKEY_keygen_init(key_ctx.get()) > 0
+                     && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx.get(), NID_X9_62_prime256v1) > 0,
+                 "key context");
+    EVP_PKEY* raw_key = nullptr;
+    CheckOpenSsl(EVP_PKEY_keygen(key_ctx.get(), &raw_key) > 0, "key generation");
+    const PKeyPtr key{raw_key};
+
+    const X509Ptr cert{X509_new()};
+    CheckOpenSsl(cert != nullptr, "X509_new");
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 60 * 60);
+    X509_set_pubkey(cert.get(), key.get());
+    X509_NAME* name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1,
+                               -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+    CheckOpenSsl(X509_sign(cert.get(), key.get(), EVP_sha256()) > 0, "X509_sign");
+
+    auto write_pem = [](const std::filesystem::path& path, auto write) {
+        std::unique_ptr<FILE, decltype(&std::fclose)> file{std::fopen(path.c_str(), "wb"), &std::fclose};
+        CheckOpenSsl(file && write(file.get()) > 0, "PEM write");
+    };
+    write_pem(cert_file, [&cert](FILE* file) {
+        return PEM_write_X509(file, cert.get());
+    });
+    write_pem(key_file, [&key](FILE* file) {
+        return PEM_write_PrivateKey(file, key.get(), nullptr, nullptr, 0, nullptr, nullptr);
+    });
+}
+
+// Способ подключения клиента
+enum class ClientMode {
+    // TLS 1.3 без возобновления
+    FULL,
+    // TLS 1.2, возобновление по session id из кэша сервера (session tickets выключены)
+    SESSION_ID_TLS12,
+    // TLS 1.2, возобновление по session ticket
+    TICKET_TLS12,
+    // TLS 1.3, возобновление по session ticket (PSK)
+    TICKET_TLS13,
+};
+
+ssl::context MakeClientContext(ClientMode mode) {
+    ssl::context ctx{ssl::context::tls_client};
+    ctx.set_verify_mode(ssl::verify_none);
+    SSL_CTX* native = ctx.native_handle();
+    if (mode == ClientMode::SESSION_ID_TLS12 || mode == ClientMode::TICKET_TLS12) {
+        SSL_CTX_set_max_proto_version(native, TLS1_2_VERSION);
+    } else {
+        SSL_CTX_set_min_proto_version(native, TLS1_3_VERSION);
+    }
+    if (mode == ClientMode::SESSION_ID_TLS12) {
+        SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+    }
+    return ctx;
+}
+
+struct HandshakeResult {
+    Clock::duration latency;
+    bool reused = false;
+};
+
+// Подключается к серверу, выполняет рукопожатие и один запрос и закрывает соединение.
+// Если session задан, клиент пытается возобновить сессию. Новая сессия, полученная
+// от сервера, сохраняется в session
+HandshakeResult Handshake(net::io_context& ioc, ssl::context& ctx, const tcp::endpoint& endpoint,
+                          SessionPtr* session) {
+    beast::ssl_stream<beast::tcp_stream> stream{ioc, ctx};
+    beast::get_lowest_layer(stream).connect(endpoint);
+    SSL* ssl = stream.native_handle();
+    if (session && *session) {
+        CheckOpenSsl(SSL_set_session(ssl, session->get()) == 1, "SSL_set_session");
+    }
+
+    const auto started_at = Clock::now();
+    stream.handshake(ssl::stream_base::client);
+    HandshakeResult result{Clock::now() - started_at, SSL_session_reused(ssl) == 1};
+
+    // В TLS 1.3 сервер отправляет session ticket после рукопожатия,
+    // клиент получает его, читая ответ
+    http::request<http::empty_body> request{http::verb::get, "/", 11};
+    request.set(http::field::host, "localhost");
+    request.keep_alive(false);
+    http::write(stream, request);
+    beast::flat_buffer buffer;
+    http::response<http::string_body> response;
+    http::read(stream, buffer, response);
+
+    if (session) {
+        session->reset(SSL_get1_session(ssl));
+    }
+    // Без close_notify OpenSSL считает сессию оборванной и удаляет её из кэша
+    beast::error_code ec;
+    stream.shutdown(ec);
+    return result;
+}
+
+double PercentileUs(std::vector<Clock::duration>& latencies, double p) {
+    std::sort(latencies.begin(), latencies.end());
+    const auto index = std::min(latencies.size() - 1, static_cast<size_t>(p * static_cast<double>(latencies.size())));
+    return std::chrono::duration<double, std::micro>(latencies[index]).count();
+}
+
+void RunFullHandshakes(const Args& args, const tcp::endpoint& endpoint) {
+    std::atomic<long long> remaining{args.handshakes};
+    std::atomic<std::uint64_t> errors{0};
+    std::vector<std::vector<Clock::duration>> latencies(args.threads);
+
+    const auto started_at = Clock::now();
+    {
+        std::vector<std::jthread> clients;
+        for (unsigned t = 0; t < args.threads; ++t) {
+            clients.emplace_back([&, t] {
+                net::io_context ioc;
+                auto ctx = MakeClientContext(ClientMode::FULL);
+                while (remaining.fetch_sub(1) > 0) {
+                    try {
+                        latencies[t].push_back(Handshake(ioc, ctx, endpoint, nullptr).latency);
+                    } catch (const std::exception&) {
+                        ++errors;
+                    }
+                }
+            });
+        }
+    }
+    const std::chrono::duration<double> elapsed = Clock::now() - started_at;
+
+    std::vector<Clock::duration> all;
+    for (const auto& thread_latencies : latencies) {
+        all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+    }
+    if (all.empty()) {
+        throw std::runtime_error("No handshake succeeded");
+    }
+    std::cout << "full: threads="sv << args.threads << " handshakes="sv << all.size() << " errors="sv << errors
+              << " handshakes_per_s="sv << static_cast<double>(all.size()) / elapsed.count()
+              << " p50_us="sv << PercentileUs(all, 0.5) << " p99_us="sv << PercentileUs(all, 0.99) << std::endl;
+}
+
+// Последовательно подключается одним клиентом. Возвращает число возобновлённых сессий
+unsigned RunSequential(std::string_view name, ClientMode mode, const Args& args, const tcp::endpoint& endpoint) {
+    net::io_context ioc;
+    auto ctx = MakeClientContext(mode);
+    SessionPtr session;
+    const bool resume = mode != ClientMode::FULL;
+    if (resume) {
+        // Первое подключение - полное рукопожатие, дающее сессию для возобновления
+        Handshake(ioc, ctx, endpoint, &session);
+    }
+
+    std::vector<Clock::duration> latencies;
+    latencies.reserve(args.resumptions);
+    unsigned reused = 0;
+    for (unsigned i = 0; i < args.resumptions; ++i) {
+        const auto result = Handshake(ioc, ctx, endpoint, resume ? &session : nullptr);
+        latencies.push_back(result.latency);
+        reused += result.reused;
+    }
+    std::cout << name << ": handshakes="sv << args.resumptions << " resumed="sv << reused
+              << " p50_us="sv << PercentileUs(latencies, 0.5) << " p99_us="sv << PercentileUs(latencies, 0.99)
+              << std::endl;
+    return reused;
+}
+
+// Возвращает свободный порт на loopback
+unsigned short FindFreePort() {
+    net::io_context ioc;
+    tcp::acceptor acceptor{ioc, tcp::endpoint{net::ip::address_v4::loopback(), 0}};
+    return acceptor.local_endpoint().port();
+}
+
+// Создаёт новый подкаталог в dir. Удалять после теста можно только его:
+// dir задаёт пользователь, и в нём могут быть чужие файлы
+std::filesystem::path MakeWorkDir(const std::filesystem::path& dir) {
+    const auto work_dir = dir / ("tls_handshake_bench."s + std::to_string(::getpid()));
+    std::filesystem::create_directories(dir);
+    if (!std::filesystem::create_directory(work_dir)) {
+        throw std::runtime_error(work_dir.string() + " already exists");
+    }
+    return work_dir;
+}
+
+bool Run(const Args& args) {
+    const auto work_dir = MakeWorkDir(args.dir);
+    const auto cert_file = work_dir / "cert.pem";
+    const auto key_file = work_dir / "key.pem";
+    WriteSelfSignedCertificate(cert_file, key_file);
+
+    const tcp::endpoint endpoint{net::ip::address_v4::loopback(), FindFreePort()};
+    net::io_context ioc{static_cast<int>(args.server_threads)};
+    http_server::ServeHttp(
+        ioc, endpoint,
+        [](http_server::StringRequest&& request, http_server::ResponseSender send, http_server::WebSocketAccept) {
+            http_server::StringResponse response{http::status::ok, request.version()};
+            response.body() = "ok"sv;
+            response.keep_alive(request.keep_alive());
+            response.prepare_payload();
+            send(std::move(response));
+        },
+        {}, http_server::MakeServerSslContext(cert_file, key_file));
+
+    std::vector<std::jthread> server_threads;
+    for (unsigned i = 0; i < args.server_threads; ++i) {
+        server_threads.emplace_back([&ioc] {
+            ioc.run();
+        });
+    }
+
+    bool resumed = true;
+    try {
+        RunFullHandshakes(args, endpoint);
+        RunSequential("full_sequential"sv, ClientMode::FULL, args, endpoint);
+        for (const auto& [name, mode] : {std::pair{"resume_session_id_tls12"sv, ClientMode::SESSION_ID_TLS12},
+                                         std::pair{"resume_ticket_tls12"sv, ClientMode::TICKET_TLS12},
+                                         std::pair{"resume_ticket_tls13"sv, ClientMode::TICKET_TLS13}}) {
+            if (RunSequential(name, mode, args, endpoint) == 0) {
+                std::cerr << name << ": server did not resume any session"sv << std::endl;
+                resumed = false;
+            }
+        }
+    } catch (...) {
+        ioc.stop();
+        std::error_code ec;
+        std::filesystem::remove_all(work_dir, ec);
+        throw;
+    }
+    ioc.stop();
+    server_threads.clear();
+    std::filesystem::remove_all(work_dir);
+    return resumed;
+}
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    Args args;
+    po::options_description desc{"Allowed options"s};
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("threads", po::value(&args.threads)->value_name("n"s), "number of client threads for full handshakes")
+        ("server-threads", po::value(&args.server_threads)->value_name("n"s), "number of server threads")
+        ("handshakes", po::value(&args.handshakes)->value_name("n"s), "number of full handshakes")
+        ("resumptions", po::value(&args.resumptions)->value_name("n"s),
+         "number of sequential handshakes per resumption mode")
+        ("dir", po::value(&args.dir)->value_name("dir"s),
+         "directory to create a temporary subdirectory for the certificate in (system temp directory by default)");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if (args.threads == 0 || args.server_threads == 0 || args.handshakes == 0 || args.resumptions == 0) {
+        throw std::runtime_error("All counts must be positive");
+    }
+    return args;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    try {
+        const auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+        return Run(*args) ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
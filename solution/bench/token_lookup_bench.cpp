@@ -0,0 +1,170 @@
+// Нагрузочный тест поиска игрока по токену из нескольких потоков.
+// Сравнивает шардированную таблицу app::PlayerTokens с таблицей под одним мьютексом
+#include <boost/program_options.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "players.h"
+
+using namespace std::literals;
+
+namespace {
+
+struct Args {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned players = 100'000;
+    unsigned lookups = 2'000'000;
+    // Каждый join_every-й запрос потока добавляет игрока (0 - только поиск)
+    unsigned join_every = 0;
+};
+
+// Таблица "токен -> игрок" под одним мьютексом - то, что заменяет app::PlayerTokens
+class MutexPlayerTokens {
+public:
+    void AddPlayer(app::Player& player) {
+        std::lock_guard lock{mutex_};
+        token_to_player_.emplace(*player.GetToken(), &player);
+    }
+
+    app::Player* FindPlayerByToken(std::string_view token) const {
+        std::lock_guard lock{mutex_};
+        if (auto it = token_to_player_.find(token); it != token_to_player_.end()) {
+            return it->second;
+        }
+        return nullptr;
+    }
+
+private:
+    struct TokenHasher {
+        using is_transparent = void;
+        size_t operator()(std::string_view token) const noexcept {
+            return std::hash<std::string_view>{}(token);
+        }
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, app::Player*, TokenHasher, std::equal_to<>> token_to_player_;
+};
+
+// Игроки одного игрового сеанса. Добавление игроков потокобезопасно
+class Fixture {
+public:
+    Fixture()
+        : map_{model::Map::Id{model::IdString{"map1"sv}}, "Map"s}
+        , session_{map_} {
+    }
+
+    app::Player& NewPlayer() {
+        std::lock_guard lock{mutex_};
+        const std::uint64_t id = next_id_++;
+        model::Dog& dog = session_.AddDog(model::Dog::Id{id}, "dog"s, {0, 0});
+        return players_.Add(app::Player::Id{id}, app::GenerateToken(), session_, dog);
+    }
+
+private:
+    model::Map map_;
+    model::GameSession session_;
+    app::Players players_;
+    std::mutex mutex_;
+    std::uint64_t next_id_ = 0;
+};
+
+template <typename Table>
+void Run(std::string_view name, const Args& args) {
+    Fixture fixture;
+    Table table;
+    std::vector<std::string> tokens;
+    tokens.reserve(args.players);
+    for (unsigned i = 0; i < args.players; ++i) {
+        app::Player& player = fixture.NewPlayer();
+        table.AddPlayer(player);
+        tokens.push_back(*player.GetToken());
+    }
+
+    std::atomic<bool> start{false};
+    std::atomic<std::uint64_t> found{0};
+    std::vector<std::jthread> workers;
+    for (unsigned t = 0; t < args.threads; ++t) {
+        workers.emplace_back([&, t] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            std::uint64_t local_found = 0;
+            size_t index = (static_cast<size_t>(t) * 7919) % tokens.size();
+            for (unsigned i = 1; i <= args.lookups; ++i) {
+                if (args.join_every != 0 && i % args.join_every == 0) {
+                    table.AddPlayer(fixture.NewPlayer());
+                    continue;
+                }
+                local_found += table.FindPlayerByToken(tokens[index]) != nullptr;
+                index += 104729;
+                if (index >= tokens.size()) {
+                    index %= tokens.size();
+                }
+            }
+            found += local_found;
+        });
+    }
+
+    const auto started_at = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    workers.clear();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started_at;
+
+    const double total = static_cast<double>(args.lookups) * args.threads;
+    std::cout << name << ": threads="sv << args.threads << " ops="sv << static_cast<std::uint64_t>(total)
+              << " found="sv << found << " elapsed_s="sv << elapsed.count()
+              << " mops="sv << total / elapsed.count() / 1e6 << std::endl;
+}
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    Args args;
+    po::options_description desc{"Allowed options"s};
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("threads", po::value(&args.threads)->value_name("n"s), "number of lookup threads")
+        ("players", po::value(&args.players)->value_name("n"s), "number of players in the table")
+        ("lookups", po::value(&args.lookups)->value_name("n"s), "number of operations per thread")
+        ("join-every", po::value(&args.join_every)->value_name("n"s),
+         "make every n-th operation a player join (0 - lookups only)");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if (args.players == 0 || args.threads == 0) {
+        throw std::runtime_error("--players and --threads must be positive");
+    }
+    return args;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    try {
+        const auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+        Run<app::PlayerTokens>("sharded_shared_mutex"sv, *args);
+        Run<MutexPlayerTokens>("single_mutex"sv, *args);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,19 @@
+// Фаззинг загрузки конфигурации игры и подготовки ответов на запросы карт.
+// Некорректная конфигурация должна отклоняться исключением std::runtime_error
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+#include "json_loader.h"
+#include "map_responses.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    try {
+        const model::Game game = json_loader::ParseGame({reinterpret_cast<const char*>(data), size});
+        const http_handler::MapResponses responses{game};
+    } catch (const std::runtime_error&) {
+        // Ожидаемый отказ на некорректной конфигурации
+    }
+    return 0;
+}
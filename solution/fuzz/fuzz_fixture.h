@@ -0,0 +1,100 @@
+#pragma once
+// Общее окружение фаззеров: игра с одной картой и обработчик запросов поверх неё.
+// Создаётся заново для каждого входа, чтобы результат не зависел от предыдущих входов
+// и число игроков не росло. Асинхронные операции выполняются в текущем потоке
+#include <boost/asio/io_context.hpp>
+
+#include <stdexcept>
+#include <string_view>
+
+#include "application.h"
+#include "json_loader.h"
+#include "request_handler.h"
+#include "state_broadcaster.h"
+#include "tracing.h"
+
+namespace fuzz {
+
+inline constexpr std::string_view CONFIG = R"({
+  "maps": [
+    {
+      "id": "map1",
+      "name": "Map 1",
+      "roads": [
+        {"x0": 0, "y0": 0, "x1": 40},
+        {"x0": 40, "y0": 0, "y1": 30},
+        {"x0": 40, "y0": 30, "x1": 0},
+        {"x0": 0, "y0": 0, "y1": 30}
+      ],
+      "buildings": [
+        {"x": 5, "y": 5, "w": 30, "h": 20}
+      ],
+      "offices": [
+        {"id": "o0", "x": 40, "y": 30, "offsetX": 5, "offsetY": 0}
+      ]
+    }
+  ]
+})";
+
+// Игрок, восстановленный из состояния: с его токеном входы могут обращаться к эндпоинтам,
+// требующим авторизации
+inline constexpr std::string_view RESTORED_TOKEN = "0123456789abcdef0123456789abcdef";
+
+// Вместо журнала. Исход сохранения входа зависит от длины имени игрока, чтобы фаззер
+// доходил и до ответа на несохранённый вход, и до исключения на strand сеанса
+class ActionListener : public app::ActionListener {
+public:
+    void OnJoinGame(const app::PlayerState& player, CommitHandler on_commit) override {
+        switch (player.name.size() % 3) {
+            case 0:
+                return on_commit(true);
+            case 1:
+                return on_commit(false);
+            default:
+                throw std::runtime_error("Failed to enqueue player join");
+        }
+    }
+};
+
+struct Fixture {
+    Fixture()
+        : game{json_loader::ParseGame(CONFIG)}
+        , application{game, ioc}
+        , broadcaster{application}
+        , handler{game, application, broadcaster} {
+        // Состояние с повторённым токеном: RestoreState должен добавить игрока один раз
+        const app::PlayerState player{app::Player::Id{0}, app::Token{std::string{RESTORED_TOKEN}}, "restored",
+                                      model::Map::Id{model::IdString{"map1"}}, {0, 0}};
+        application.RestoreState({1, {player, player}});
+        application.SetActionListener(&action_listener);
+        // Служебный эндпоинт трассировки тоже разбирает ввод клиента (см. HandleAdminRequest)
+        handler.SetTracer(&GetTracer());
+    }
+
+    // Трассировщик общий для всех входов: поток запоминает свой буфер по адресу трассировщика,
+    // и новый трассировщик по тому же адресу получил бы уже освобождённый буфер.
+    // Буферы потоков ограничены BUFFER_CAPACITY, поэтому память не растёт
+    static tracing::Tracer& GetTracer() {
+        static tracing::Tracer tracer{1};
+        return tracer;
+    }
+
+    // Выполняет операции, поставленные обработчиком на strand игровых сеансов и сессий.
+    // Тик рассылки отпускает закрытые WebSocket-соединения, иначе они копились бы между запусками
+    void RunPending() {
+        ioc.restart();
+        ioc.run();
+        broadcaster.Tick();
+        ioc.restart();
+        ioc.run();
+    }
+
+    boost::asio::io_context ioc;
+    model::Game game;
+    app::Application application;
+    http_handler::StateBroadcaster broadcaster;
+    http_handler::RequestHandler handler;
+    ActionListener action_listener;
+};
+
+}  // namespace fuzz
@@ -0,0 +1,56 @@
+// Фаззинг маршрутизации запросов: вход разбирается как HTTP-запрос и передаётся RequestHandler.
+// Ищет падения и неопределённое поведение при разборе путей, токенов, заголовков и тел запросов
+#include "sdk.h"
+//
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/beast/http.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fuzz_fixture.h"
+
+namespace {
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+// Ограничение тела такое же, как у сервера по умолчанию
+constexpr std::uint64_t BODY_LIMIT = 1024 * 1024;
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    fuzz::Fixture fixture;
+
+    http::request_parser<http::string_body> parser;
+    parser.eager(true);
+    parser.body_limit(BODY_LIMIT);
+
+    beast::error_code ec;
+    const auto* input = reinterpret_cast<const char*>(data);
+    std::size_t consumed = 0;
+    while (consumed < size && !parser.is_done()) {
+        const std::size_t n = parser.put(boost::asio::buffer(input + consumed, size - consumed), ec);
+        if (ec || n == 0) {
+            break;
+        }
+        consumed += n;
+    }
+    if (!ec && !parser.is_done()) {
+        parser.put_eof(ec);
+    }
+    if (ec || !parser.is_done()) {
+        return 0;
+    }
+
+    // Ответы отбрасываются: важно только, что обработчик не падает.
+    // Тот же запрос получает и обработчик служебного листенера
+    http_server::ResponseSender send{[](auto&&) {}};
+    auto request = parser.release();
+    fixture.handler.HandleAdminRequest(http_server::StringRequest{request}, send);
+    fixture.handler(std::move(request), std::move(send));
+    fixture.RunPending();
+    return 0;
+}
@@ -0,0 +1,37 @@
+// Фаззинг HTTP-сессии: вход подаётся как байты от клиента в Session поверх beast::test::stream.
+// В отличие от fuzz_routing проверяет и сам цикл сессии: keep-alive, конвейер запросов,
+// переход на WebSocket, ответ на ошибку обработчика и закрытие соединения
+#include "sdk.h"
+//
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/beast/_experimental/test/stream.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "fuzz_fixture.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    namespace test = boost::beast::test;
+
+    fuzz::Fixture fixture;
+
+    test::stream server{fixture.ioc};
+    test::stream client{fixture.ioc};
+    server.connect(client);
+    server.append({reinterpret_cast<const char*>(data), size});
+    // Клиент больше ничего не отправит: после разбора всех запросов сессия получит конец потока
+    client.close_remote();
+
+    auto handler = [&fixture](auto&& req, auto&& send, auto&& accept_websocket) {
+        fixture.handler(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send),
+                        std::forward<decltype(accept_websocket)>(accept_websocket));
+    };
+    using FuzzSession = http_server::Session<test::stream, decltype(handler)>;
+    std::make_shared<FuzzSession>(std::move(server), handler, http_server::SessionServices{})->Run();
+    fixture.RunPending();
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include "application.h"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+namespace app {
+using namespace std::literals;
+
+Application::Application(model::Game& game, net::io_context& ioc)
+    : game_{game} {
+    // Для каждой карты заранее создаём игровой сеанс со своим strand
+    for (const auto& map : game_.GetMaps()) {
+        sessions_.emplace(map.GetId(), SessionEntry{model::GameSession{map}, net::make_strand(ioc), {}});
+    }
+}
+
+Application::SessionEntry& Application::GetSessionEntry(const model::Map::Id& map_id) {
+    auto it = sessions_.find(map_id);
+    if (it == sessions_.end()) {
+        throw std::invalid_argument("Map "s + std::string{*map_id} + " not found"s);
+    }
+    return it->second;
+}
+
+const model::GameSession& Application::GetSession(const model::Map::Id& map_id) {
+    return GetSessionEntry(map_id).session;
+}
+
+Application::Strand& Application::GetSessionStrand(const model::Map::Id& map_id) {
+    return GetSessionEntry(map_id).strand;
+}
+
+Application::PlayerEntry& Application::AddPlayer(SessionEntry& entry, Player::Id id, Token token, model::Dog& dog,
+                                                 bool committed) {
+    Player& player = players_.Add(id, std::move(token), entry.session, dog);
+    PlayerEntry& player_entry = entry.players.emplace_back(player, committed);
+    tokens_.AddPlayer(player);
+    return player_entry;
+}
+
+void Application::JoinGame(const model::Map::Id& map_id, std::string user_name, JoinGameHandler handler) {
+    SessionEntry& entry = GetSessionEntry(map_id);
+
+    // Токен занимаем до изменения сеанса, чтобы совпадение с уже выданным токеном
+    // не оставило наполовину добавленного игрока
+    Token token = GenerateToken();
+    while (!tokens_.ReserveToken(token)) {
+        token = GenerateToken();
+    }
+
+    const Player::Id player_id{next_player_id_++};
+    model::Dog& dog = entry.session.AddDog(model::Dog::Id{*player_id}, std::move(user_name));
+    // Без получателя уведомлений сохранять вход некуда, он считается подтверждённым сразу
+    PlayerEntry& player_entry = AddPlayer(entry, player_id, std::move(token), dog, !action_listener_);
+    const Player& player = *player_entry.player;
+
+    JoinGameResult result{player.GetToken(), player_id};
+    if (!action_listener_) {
+        return handler(std::move(result));
+    }
+    action_listener_->OnJoinGame({player_id, player.GetToken(), dog.GetName(), map_id, dog.GetPosition()},
+                                 [&player_entry, handler = std::move(handler),
+                                  result = std::move(result)](bool committed) mutable {
+                                     // Несохранённый игрок остаётся в памяти до перезапуска, но его токен
+                                     // клиенту не выдаётся, а в снимки состояния он не попадает
+                                     if (!committed) {
+                                         return handler(std::nullopt);
+                                     }
+                                     player_entry.committed = true;
+                                     handler(std::move(result));
+                                 });
+}
+
+std::vector<PlayerInfo> Application::GetSessionPlayers(const Player& player) const {
+    std::vector<PlayerInfo> result;
+    const auto& dogs = player.GetSession().GetDogs();
+    result.reserve(dogs.size());
+    for (const auto& dog : dogs) {
+        result.push_back({Player::Id{*dog.GetId()}, dog.GetName()});
+    }
+    return result;
+}
+
+void Application::CollectSessionState(const SessionEntry& entry, std::vector<PlayerState>& players) {
+    for (const PlayerEntry& player_entry : entry.players) {
+        // Снимок с неподтверждённым входом вернул бы после перезапуска игрока,
+        // токен которого клиент так и не получил
+        if (!player_entry.committed) {
+            continue;
+        }
+        const Player* player = player_entry.player;
+        const model::Dog& dog = player->GetDog();
+        players.push_back({player->GetId(), player->GetToken(), dog.GetName(),
+                           entry.session.GetMap().GetId(), dog.GetPosition()});
+    }
+}
+
+void Application::AsyncCollectState(CollectStateHandler handler) {
+    struct Collector {
+        std::mutex mutex;
+        GameState state;
+        std::chrono::nanoseconds max_pause{0};
+        size_t pending_sessions = 0;
+        CollectStateHandler handler;
+    };
+
+    auto collector = std::make_shared<Collector>();
+    collector->pending_sessions = sessions_.size();
+    collector->handler = std::move(handler);
+
+    if (sessions_.empty()) {
+        collector->state.next_player_id = next_player_id_;
+        return collector->handler(std::move(collector->state), collector->max_pause);
+    }
+
+    for (auto& [map_id, entry] : sessions_) {
+        net::post(entry.strand, [this, collector, &entry] {
+            // Копируем состояние сеанса, пока обработка его запросов приостановлена
+            const auto start = std::chrono::steady_clock::now();
+            std::vector<PlayerState> players;
+            players.reserve(entry.players.size());
+            CollectSessionState(entry, players);
+            const auto pause = std::chrono::steady_clock::now() - start;
+
+            std::unique_lock lock{collector->mutex};
+            auto& state_players = collector->state.players;
+            state_players.insert(state_players.end(), std::make_move_iterator(players.begin()),
+                                 std::make_move_iterator(players.end()));
+            collector->max_pause = std::max<std::chrono::nanoseconds>(collector->max_pause, pause);
+            if (--collector->pending_sessions == 0) {
+                lock.unlock();
+                // Счётчик читаем после копирования всех сеансов, поэтому он больше любого сохранённого id
+                collector->state.next_player_id = next_player_id_;
+                collector->handler(std::move(collector->state), collector->max_pause);
+            }
+        });
+    }
+}
+
+GameState Application::CollectState() const {
+    GameState state;
+    state.next_player_id = next_player_id_;
+    for (const auto& [map_id, entry] : sessions_) {
+        CollectSessionState(entry, state.players);
+    }
+    return state;
+}
+
+void Application::RestoreState(const GameState& state) {
+    for (const auto& player_state : state.players) {
+        if (tokens_.FindPlayerByToken(*player_state.token)) {
+            continue;
+        }
+        SessionEntry& entry = GetSessionEntry(player_state.map_id);
+        model::Dog& dog = entry.session.AddDog(model::Dog::Id{*player_state.id}, player_state.name,
+                                               player_state.position);
+        AddPlayer(entry, player_state.id, player_state.token, dog, true);
+    }
+    std::uint64_t next_player_id = std::max<std::uint64_t>(next_player_id_, state.next_player_id);
+    for (const auto& player_state : state.players) {
+        next_player_id = std::max(next_player_id, *player_state.id + 1);
+    }
+    next_player_id_ = next_player_id;
+}
+
+}  // namespace app
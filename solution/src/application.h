@@ -0,0 +1,157 @@
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "model.h"
+#include "players.h"
+
+namespace app {
+
+namespace net = boost::asio;
+
+struct JoinGameResult {
+    Token token;
+    Player::Id player_id;
+};
+
+struct PlayerInfo {
+    Player::Id id;
+    std::string name;
+};
+
+// Сохраняемое состояние игрока
+struct PlayerState {
+    Player::Id id;
+    Token token;
+    std::string name;
+    model::Map::Id map_id;
+    model::Point position;
+};
+
+// Сохраняемое состояние игры
+struct GameState {
+    std::uint64_t next_player_id = 0;
+    std::vector<PlayerState> players;
+};
+
+// Получает уведомления о действиях игроков, изменяющих состояние игры
+class ActionListener {
+public:
+    // committed = false, если действие не удалось сохранить
+    using CommitHandler = std::function<void(bool committed)>;
+
+    // Вызывается на strand сеанса после входа игрока.
+    // on_commit нужно вызвать, когда действие надёжно сохранено или сохранить его не удалось
+    virtual void OnJoinGame(const PlayerState& player, CommitHandler on_commit) = 0;
+
+protected:
+    ~ActionListener() = default;
+};
+
+// Сценарии использования игры: вход игрока, получение списка игроков и т.п.
+// У каждого игрового сеанса свой strand: операции, изменяющие или читающие
+// состояние сеанса, должны выполняться на нём, поэтому блокировки не нужны
+class Application {
+public:
+    using Strand = net::strand<net::io_context::executor_type>;
+    // Получает собранное состояние и наибольшую паузу, на которую был занят strand сеанса
+    using CollectStateHandler = std::function<void(GameState state, std::chrono::nanoseconds max_pause)>;
+    // Получает std::nullopt, если вход игрока не удалось надёжно сохранить
+    using JoinGameHandler = std::function<void(std::optional<JoinGameResult> result)>;
+
+    Application(model::Game& game, net::io_context& ioc);
+
+    Application(const Application&) = delete;
+    Application& operator=(const Application&) = delete;
+
+    const model::Game& GetGame() const noexcept {
+        return game_;
+    }
+
+    // Возвращает игровой сеанс на карте map_id. Состояние сеанса читается на его strand.
+    // Выбрасывает std::invalid_argument, если карта не найдена
+    const model::GameSession& GetSession(const model::Map::Id& map_id);
+
+    // Возвращает strand игрового сеанса на карте map_id.
+    // Выбрасывает std::invalid_argument, если карта не найдена
+    Strand& GetSessionStrand(const model::Map::Id& map_id);
+
+    // Задаёт получателя уведомлений о действиях игроков. Вызывается до начала обработки запросов
+    void SetActionListener(ActionListener* listener) noexcept {
+        action_listener_ = listener;
+    }
+
+    // Добавляет игрока с именем user_name на карту map_id.
+    // handler вызывается, когда ActionListener подтвердит сохранение действия
+    // (сразу, если получатель не задан).
+    // Выбрасывает std::invalid_argument, если карта не найдена.
+    // Вызывается на strand игрового сеанса
+    void JoinGame(const model::Map::Id& map_id, std::string user_name, JoinGameHandler handler);
+
+    Player* FindPlayerByToken(std::string_view token) const noexcept {
+        return tokens_.FindPlayerByToken(token);
+    }
+
+    // Возвращает игроков, находящихся в том же игровом сеансе, что и player.
+    // Вызывается на strand игрового сеанса игрока
+    std::vector<PlayerInfo> GetSessionPlayers(const Player& player) const;
+
+    // Асинхронно собирает состояние всех сеансов. Каждый сеанс копируется на своём strand,
+    // поэтому обработка запросов приостанавливается только на время копирования.
+    // В состояние попадают только игроки, вход которых подтверждён ActionListener.
+    // handler вызывается на strand последнего скопированного сеанса
+    void AsyncCollectState(CollectStateHandler handler);
+
+    // Синхронно собирает состояние подтверждённых игроков.
+    // Вызывается, только когда обработка запросов остановлена
+    GameState CollectState() const;
+
+    // Восстанавливает состояние. Вызывается до начала обработки запросов.
+    // Уже известные игроки пропускаются, поэтому состояние можно применять повторно.
+    // Выбрасывает std::invalid_argument, если карта игрока не найдена
+    void RestoreState(const GameState& state);
+
+private:
+    struct PlayerEntry {
+        PlayerEntry(const Player& player, bool committed) noexcept
+            : player{&player}
+            , committed{committed} {
+        }
+
+        const Player* player;
+        // Вход игрока подтверждён ActionListener. Флаг выставляется в потоке получателя уведомлений
+        std::atomic<bool> committed;
+    };
+
+    struct SessionEntry {
+        model::GameSession session;
+        Strand strand;
+        // deque сохраняет адреса элементов, на них ссылаются обработчики подтверждения
+        std::deque<PlayerEntry> players;
+    };
+
+    using MapIdHasher = util::TaggedHasher<model::Map::Id>;
+    using Sessions = std::unordered_map<model::Map::Id, SessionEntry, MapIdHasher>;
+
+    SessionEntry& GetSessionEntry(const model::Map::Id& map_id);
+    PlayerEntry& AddPlayer(SessionEntry& entry, Player::Id id, Token token, model::Dog& dog, bool committed);
+    static void CollectSessionState(const SessionEntry& entry, std::vector<PlayerState>& players);
+
+    model::Game& game_;
+    Sessions sessions_;
+    Players players_;
+    PlayerTokens tokens_;
+    std::atomic<std::uint64_t> next_player_id_{0};
+    ActionListener* action_listener_ = nullptr;
+};
+
+}  // namespace app
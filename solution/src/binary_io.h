@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace binary_io {
+
+// Запись значений в компактном двоичном виде (little-endian, как на целевой платформе x86-64).
+// Строки записываются как длина (uint32) и следом байты строки
+class BinaryWriter {
+public:
+    template <typename T>
+    void Write(T value) {
+        static_assert(std::is_arithmetic_v<T>);
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        buffer_.append(bytes, sizeof(T));
+    }
+
+    void WriteString(std::string_view str) {
+        Write(static_cast<std::uint32_t>(str.size()));
+        buffer_.append(str);
+    }
+
+    void WriteBytes(std::string_view bytes) {
+        buffer_.append(bytes);
+    }
+
+    const std::string& GetBuffer() const noexcept {
+        return buffer_;
+    }
+
+    std::string& GetBuffer() noexcept {
+        return buffer_;
+    }
+
+private:
+    std::string buffer_;
+};
+
+// Чтение значений, записанных BinaryWriter.
+// Выбрасывает std::runtime_error при выходе за границы данных
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data) noexcept
+        : data_{data} {
+    }
+
+    template <typename T>
+    T Read() {
+        static_assert(std::is_arithmetic_v<T>);
+        T value;
+        std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string ReadString() {
+        const auto size = Read<std::uint32_t>();
+        return std::string{Take(size)};
+    }
+
+    std::string_view ReadBytes(size_t size) {
+        return Take(size);
+    }
+
+    bool IsEnd() const noexcept {
+        return pos_ == data_.size();
+    }
+
+    size_t GetPosition() const noexcept {
+        return pos_;
+    }
+
+private:
+    std::string_view Take(size_t size) {
+        if (data_.size() - pos_ < size) {
+            throw std::runtime_error("Unexpected end of binary data");
+        }
+        auto result = data_.substr(pos_, size);
+        pos_ += size;
+        return result;
+    }
+
+    std::string_view data_;
+    size_t pos_ = 0;
+};
+
+}  // namespace binary_io
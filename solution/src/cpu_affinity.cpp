@@ -0,0 +1,92 @@
+#include "cpu_affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <cerrno>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace util {
+
+using namespace std::literals;
+
+namespace {
+
+unsigned ParseCpuNumber(std::string_view str, std::string_view cpu_list) {
+    unsigned value = 0;
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (str.empty() || ec != std::errc{} || ptr != str.data() + str.size() || value >= CPU_SETSIZE) {
+        throw std::invalid_argument("Invalid CPU list: "s + std::string(cpu_list));
+    }
+    return value;
+}
+
+}  // namespace
+
+std::vector<unsigned> ParseCpuList(std::string_view cpu_list) {
+    std::vector<unsigned> cpus;
+    std::string_view rest = cpu_list;
+    while (!rest.empty()) {
+        const auto comma_pos = rest.find(',');
+        const std::string_view item = rest.substr(0, comma_pos);
+        rest.remove_prefix(comma_pos == std::string_view::npos ? rest.size() : comma_pos + 1);
+
+        const auto dash_pos = item.find('-');
+        if (dash_pos == std::string_view::npos) {
+            cpus.push_back(ParseCpuNumber(item, cpu_list));
+            continue;
+        }
+        const unsigned first = ParseCpuNumber(item.substr(0, dash_pos), cpu_list);
+        const unsigned last = ParseCpuNumber(item.substr(dash_pos + 1), cpu_list);
+        if (first > last) {
+            throw std::invalid_argument("Invalid CPU list: "s + std::string(cpu_list));
+        }
+        for (unsigned cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty()) {
+        throw std::invalid_argument("Empty CPU list"s);
+    }
+    return cpus;
+}
+
+std::vector<unsigned> GetAvailableCpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        throw std::system_error(errno, std::generic_category(), "sched_getaffinity");
+    }
+    std::vector<unsigned> cpus;
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+void PinCurrentThread(unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    // pthread-функции возвращают код ошибки, а не выставляют errno
+    if (const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); err != 0) {
+        throw std::system_error(err, std::generic_category(), "Failed to pin thread to CPU "s + std::to_string(cpu));
+    }
+}
+
+std::optional<unsigned> GetCpuSocket(unsigned cpu) {
+    std::ifstream file("/sys/devices/system/cpu/cpu"s + std::to_string(cpu) + "/topology/physical_package_id"s);
+    int socket = -1;
+    if (!(file >> socket) || socket < 0) {
+        return std::nullopt;
+    }
+    return static_cast<unsigned>(socket);
+}
+
+}  // namespace util
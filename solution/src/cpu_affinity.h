@@ -0,0 +1,23 @@
+#pragma once
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace util {
+
+// Разбирает список процессоров вида "0-3,8,10-11".
+// Выбрасывает std::invalid_argument, если список задан неверно
+std::vector<unsigned> ParseCpuList(std::string_view cpu_list);
+
+// Возвращает процессоры, на которых процессу разрешено выполняться
+std::vector<unsigned> GetAvailableCpus();
+
+// Привязывает текущий поток к процессору cpu.
+// Выбрасывает std::system_error в случае ошибки
+void PinCurrentThread(unsigned cpu);
+
+// Возвращает номер физического процессорного сокета (NUMA-узла, на машинах, где они совпадают),
+// которому принадлежит процессор cpu, или std::nullopt, если топология недоступна
+std::optional<unsigned> GetCpuSocket(unsigned cpu);
+
+}  // namespace util
@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+/**
+ * Строка ограниченной длины, хранящая символы внутри объекта, без выделения памяти.
+ * Вместе со строкой хранится её хеш, вычисленный при создании, поэтому хеширование
+ * ничего не стоит, а сравнение на неравенство обычно заканчивается на сравнении хешей.
+ * Подходит для коротких идентификаторов, например, в качестве значения util::Tagged:
+ *
+ *  using Id = util::Tagged<util::FixedString<31>, Map>;
+ *  Id id{Id::ValueType{"map1"sv}};
+ *  std::unordered_map<Id, Map, util::TaggedHasher<Id>> maps;  // использует сохранённый хеш
+ */
+template <size_t Capacity>
+class FixedString {
+    static_assert(Capacity > 0 && Capacity <= 255, "Length of FixedString must fit into one byte");
+
+public:
+    static constexpr size_t CAPACITY = Capacity;
+
+    constexpr FixedString() noexcept
+        : hash_{ComputeHash({})} {
+    }
+
+    // Выбрасывает std::length_error, если строка длиннее CAPACITY
+    constexpr explicit FixedString(std::string_view str)
+        : size_{CheckedSize(str)}
+        , hash_{ComputeHash(str)} {
+        for (size_t i = 0; i < str.size(); ++i) {
+            data_[i] = str[i];
+        }
+    }
+
+    // Проверяет, поместится ли строка в FixedString
+    static constexpr bool Fits(std::string_view str) noexcept {
+        return str.size() <= CAPACITY;
+    }
+
+    constexpr std::string_view View() const noexcept {
+        return {data_.data(), size_};
+    }
+
+    constexpr operator std::string_view() const noexcept {
+        return View();
+    }
+
+    constexpr size_t Size() const noexcept {
+        return size_;
+    }
+
+    constexpr bool Empty() const noexcept {
+        return size_ == 0;
+    }
+
+    // Хеш, вычисленный при создании строки
+    constexpr size_t Hash() const noexcept {
+        return hash_;
+    }
+
+    constexpr bool operator==(const FixedString& other) const noexcept {
+        return hash_ == other.hash_ && View() == other.View();
+    }
+
+    constexpr auto operator<=>(const FixedString& other) const noexcept {
+        return View() <=> other.View();
+    }
+
+    // FNV-1a. Вычисляется и во время компиляции
+    static constexpr size_t ComputeHash(std::string_view str) noexcept {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char c : str) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+
+private:
+    static constexpr std::uint8_t CheckedSize(std::string_view str) {
+        if (!Fits(str)) {
+            throw std::length_error("String is longer than " + std::to_string(CAPACITY) + " characters");
+        }
+        return static_cast<std::uint8_t>(str.size());
+    }
+
+    std::array<char, Capacity> data_{};
+    std::uint8_t size_ = 0;
+    size_t hash_;
+};
+
+}  // namespace util
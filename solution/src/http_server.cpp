@@ -3,54 +3,103 @@
 namespace http_server {
 using namespace std::literals;
 
+namespace {
+
+std::atomic<std::uint64_t> next_connection_id{0};
+
+}  // namespace
+
 void ReportError(beast::error_code ec, std::string_view what) {
     std::cerr << what << ": " << ec.message() << std::endl;
 }
 
-void SessionBase::Run() {
-    net::dispatch(stream_.get_executor(),
-                  beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
+std::uint64_t NextConnectionId() noexcept {
+    return next_connection_id++;
 }
 
-void SessionBase::Read() {
-    using namespace std::literals;
-    request_ = {};
-    stream_.expires_after(30s);
-
-    http::async_read(stream_, buffer_, request_,
-                     beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis()));
+void ConnectionTracker::AddListener(std::weak_ptr<Drainable> listener) {
+    {
+        std::lock_guard lock{mutex_};
+        if (!draining_) {
+            listeners_.push_back(std::move(listener));
+            return;
+        }
+    }
+    if (auto drainable = listener.lock()) {
+        drainable->Drain();
+    }
 }
 
-void SessionBase::OnRead(beast::error_code ec, std::size_t bytes_read) {
-    using namespace std::literals;
-
-    if (ec == http::error::end_of_stream) {
-        return Close();
+ConnectionTracker::Key ConnectionTracker::AddSession(std::weak_ptr<Drainable> session) {
+    Key key;
+    {
+        std::lock_guard lock{mutex_};
+        key = next_key_++;
+        sessions_.emplace(key, session);
+        if (!draining_) {
+            return key;
+        }
     }
-    if (ec) {
-        return ReportError(ec, "read"sv);
+    // Сессия принята уже после начала остановки
+    if (auto drainable = session.lock()) {
+        drainable->Drain();
     }
-    HandleRequest(std::move(request_));
+    return key;
 }
 
-void SessionBase::OnWrite(bool close, beast::error_code ec, std::size_t bytes_written) {
-    if (ec) {
-        return ReportError(ec, "write"sv);
-    }
+void ConnectionTracker::RemoveSession(Key key) noexcept {
+    std::lock_guard lock{mutex_};
+    sessions_.erase(key);
+}
 
-    if (close) {
-        return Close();
+void ConnectionTracker::StartDrain() {
+    std::vector<std::shared_ptr<Drainable>> to_drain;
+    {
+        std::lock_guard lock{mutex_};
+        if (draining_.exchange(true)) {
+            return;
+        }
+        to_drain.reserve(listeners_.size() + sessions_.size());
+        for (const auto& listener : listeners_) {
+            if (auto drainable = listener.lock()) {
+                to_drain.push_back(std::move(drainable));
+            }
+        }
+        for (const auto& [key, session] : sessions_) {
+            if (auto drainable = session.lock()) {
+                to_drain.push_back(std::move(drainable));
+            }
+        }
+    }
+    // Drain вызываем без блокировки: сессия может успеть завершиться и удалить себя из реестра
+    for (const auto& drainable : to_drain) {
+        drainable->Drain();
     }
+}
 
-    Read();
+size_t ConnectionTracker::GetActiveSessions() const {
+    std::lock_guard lock{mutex_};
+    return sessions_.size();
 }
 
-void SessionBase::Close() {
-    beast::error_code ec;
-    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
-    if (ec) {
-        ReportError(ec, "socket shutdown"sv);
-    }
+std::shared_ptr<ssl::context> MakeServerSslContext(const std::filesystem::path& cert_chain_file,
+                                                   const std::filesystem::path& private_key_file) {
+    auto ctx = std::make_shared<ssl::context>(ssl::context::tls_server);
+    ctx->set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 | ssl::context::no_sslv3
+                     | ssl::context::no_tlsv1 | ssl::context::no_tlsv1_1 | ssl::context::single_dh_use);
+    ctx->use_certificate_chain_file(cert_chain_file.string());
+    ctx->use_private_key_file(private_key_file.string(), ssl::context::pem);
+
+    // Кэш сессий на сервере (возобновление по session id) и session tickets
+    // (возобновление без состояния на сервере) позволяют клиенту не повторять полное рукопожатие
+    constexpr std::string_view SESSION_ID_CONTEXT = "game_server"sv;
+    SSL_CTX* native = ctx->native_handle();
+    SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(native, 20 * 1024);
+    SSL_CTX_set_session_id_context(native, reinterpret_cast<const unsigned char*>(SESSION_ID_CONTEXT.data()),
+                                   static_cast<unsigned>(SESSION_ID_CONTEXT.size()));
+    SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+    return ctx;
 }
 
 }  // namespace http_server
@@ -5,45 +5,541 @@
 
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/v6_only.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/asio/ssl.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <boost/optional.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tracing.h"
+#include "traffic_capture.h"
 
 namespace http_server {
 
 namespace net = boost::asio;
+namespace ssl = net::ssl;
 using tcp = net::ip::tcp;
 namespace beast = boost::beast;
 namespace http = beast::http;
+namespace websocket = beast::websocket;
 namespace sys = boost::system;
 using StringRequest = http::request<http::string_body>;
 using StringResponse = http::response<http::string_body>;
 void ReportError(beast::error_code ec, std::string_view what);
 
-class SessionBase {
+// Тело HTTP-ответа, разделяющее неизменяемую строку с другими ответами без копирования,
+// например, заранее сериализованную карту. Строка живёт, пока на неё ссылается хотя бы один ответ
+struct SharedStringBody {
+    using value_type = std::shared_ptr<const std::string>;
+
+    static std::uint64_t size(const value_type& body) noexcept {
+        return body ? body->size() : 0;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, typename Fields>
+        writer([[maybe_unused]] const http::header<isRequest, Fields>& header, const value_type& body) noexcept
+            : body_{body} {
+        }
+
+        void init(beast::error_code& ec) noexcept {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) noexcept {
+            ec = {};
+            if (done_ || !body_) {
+                return boost::none;
+            }
+            done_ = true;
+            return std::make_pair(const_buffers_type{body_->data(), body_->size()}, false);
+        }
+
+    private:
+        const value_type& body_;
+        bool done_ = false;
+    };
+};
+
+using SharedStringResponse = http::response<SharedStringBody>;
+
+// Отправляет ответ на запрос. Принимает ответ как с собственным телом, так и с разделяемым
+class ResponseSender {
+public:
+    template <typename Fn>
+    ResponseSender(Fn send)
+        : send_string_(send)
+        , send_shared_(std::move(send)) {
+    }
+
+    void operator()(StringResponse&& response) const {
+        send_string_(std::move(response));
+    }
+
+    void operator()(SharedStringResponse&& response) const {
+        send_shared_(std::move(response));
+    }
+
+private:
+    std::function<void(StringResponse&&)> send_string_;
+    std::function<void(SharedStringResponse&&)> send_shared_;
+};
+
+// Потоки, поверх которых работают сессии: обычный TCP и TLS поверх TCP
+using TcpStream = beast::tcp_stream;
+using SslStream = beast::ssl_stream<beast::tcp_stream>;
+
+template <typename Stream>
+constexpr bool IS_SSL_STREAM = std::is_same_v<Stream, SslStream>;
+
+// Операции с нижним уровнем потока. Сессии работают и поверх потока без таймаутов и сокета
+// (beast::test::stream в фаззере): такой поток вместо отмены операций и закрытия на запись закрывается
+namespace detail {
+
+template <typename Stream>
+concept HasTimeouts = requires(Stream& stream) {
+    stream.expires_never();
+    stream.cancel();
+};
+
+template <typename Stream>
+void ExpiresAfter(Stream& stream, std::chrono::steady_clock::duration timeout) {
+    auto& lowest = beast::get_lowest_layer(stream);
+    if constexpr (HasTimeouts<std::remove_reference_t<decltype(lowest)>>) {
+        lowest.expires_after(timeout);
+    }
+}
+
+template <typename Stream>
+void ExpiresNever(Stream& stream) {
+    auto& lowest = beast::get_lowest_layer(stream);
+    if constexpr (HasTimeouts<std::remove_reference_t<decltype(lowest)>>) {
+        lowest.expires_never();
+    }
+}
+
+template <typename Stream>
+void Cancel(Stream& stream) {
+    auto& lowest = beast::get_lowest_layer(stream);
+    if constexpr (HasTimeouts<std::remove_reference_t<decltype(lowest)>>) {
+        lowest.cancel();
+    } else {
+        lowest.close();
+    }
+}
+
+template <typename Stream>
+void ShutdownSend(Stream& stream, beast::error_code& ec) {
+    if constexpr (requires { stream.socket(); }) {
+        stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+    } else {
+        stream.close();
+    }
+}
+
+}  // namespace detail
+
+// Создаёт контекст TLS-сервера с кэшем сессий и поддержкой session tickets,
+// чтобы повторные подключения клиентов обходились сокращённым рукопожатием
+std::shared_ptr<ssl::context> MakeServerSslContext(const std::filesystem::path& cert_chain_file,
+                                                   const std::filesystem::path& private_key_file);
+
+// Возвращает уникальный номер нового соединения
+std::uint64_t NextConnectionId() noexcept;
+
+// Учитывает активные сессии и обрабатываемые запросы и позволяет плавно остановить сервер:
+// листенеры перестают принимать соединения, простаивающие сессии закрываются,
+// а остальные закрываются после отправки текущего ответа с заголовком Connection: close
+class ConnectionTracker {
+public:
+    // Объект, который нужно уведомить о начале завершения работы сервера
+    class Drainable {
+    public:
+        // Может вызываться из любого потока
+        virtual void Drain() = 0;
+
+    protected:
+        ~Drainable() = default;
+    };
+
+    using Key = std::uint64_t;
+
+    // Регистрирует листенер. Листенеры не учитываются в числе активных сессий
+    void AddListener(std::weak_ptr<Drainable> listener);
+
+    // Регистрирует сессию. Если сервер уже завершает работу, сессия сразу уведомляется об этом
+    Key AddSession(std::weak_ptr<Drainable> session);
+    void RemoveSession(Key key) noexcept;
+
+    void OnRequestStarted() noexcept {
+        ++in_flight_requests_;
+    }
+
+    void OnRequestFinished() noexcept {
+        --in_flight_requests_;
+    }
+
+    bool IsDraining() const noexcept {
+        return draining_;
+    }
+
+    // Начинает плавное завершение работы
+    void StartDrain();
+
+    size_t GetActiveSessions() const;
+
+    size_t GetInFlightRequests() const noexcept {
+        return in_flight_requests_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::weak_ptr<Drainable>> listeners_;
+    std::unordered_map<Key, std::weak_ptr<Drainable>> sessions_;
+    Key next_key_ = 0;
+    std::atomic<size_t> in_flight_requests_{0};
+    std::atomic<bool> draining_{false};
+};
+
+// Общие службы сервера, которыми пользуются сессии. Любая из них может отсутствовать
+struct SessionServices {
+    // Запись трафика
+    traffic::TrafficRecorder* recorder = nullptr;
+    // Учёт соединений для плавной остановки
+    ConnectionTracker* tracker = nullptr;
+    // Выборочная трассировка запросов
+    tracing::Tracer* tracer = nullptr;
+};
+
+// WebSocket-соединение, не зависящее от типа потока.
+// Одно и то же сообщение может разделяться между многими соединениями без копирования
+class WebSocketConnection {
+public:
+    using Message = std::shared_ptr<const std::string>;
+
+    // Завершает установку соединения в ответ на запрос request
+    virtual void Run(StringRequest&& request) = 0;
+
+    // Потокобезопасно ставит сообщение в очередь на отправку.
+    // Возвращает false, если соединение закрыто
+    virtual bool Send(Message message) = 0;
+
+    // Потокобезопасно проверяет, закрыто ли соединение или начато ли его закрытие
+    virtual bool IsClosed() const noexcept = 0;
+
+protected:
+    ~WebSocketConnection() = default;
+};
+
+// Передаётся обработчику запроса на установку WebSocket-соединения.
+// Забирает поток у HTTP-сессии и возвращает WebSocket-соединение, для обычных запросов пуст
+using WebSocketAccept = std::function<std::shared_ptr<WebSocketConnection>()>;
+
+template <typename Stream>
+class WebSocketSession : public WebSocketConnection,
+                         public ConnectionTracker::Drainable,
+                         public std::enable_shared_from_this<WebSocketSession<Stream>> {
+public:
+    // tracker может быть nullptr
+    WebSocketSession(Stream&& stream, ConnectionTracker* tracker)
+        : ws_(std::move(stream))
+        , tracker_(tracker) {
+    }
+
+    WebSocketSession(const WebSocketSession&) = delete;
+    WebSocketSession& operator=(const WebSocketSession&) = delete;
+
+    ~WebSocketSession() {
+        Unregister();
+    }
+
+    void Run(StringRequest&& request) override {
+        if (tracker_) {
+            tracker_key_ = tracker_->AddSession(this->weak_from_this());
+        }
+        net::dispatch(ws_.get_executor(), [self = this->shared_from_this(), request = std::move(request)] {
+            // У WebSocket свои таймауты, таймаут TCP-потока отключаем
+            detail::ExpiresNever(self->ws_);
+            self->ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+            self->ws_.async_accept(request, beast::bind_front_handler(&WebSocketSession::OnAccept, self));
+        });
+    }
+
+    bool Send(Message message) override {
+        if (closed_) {
+            return false;
+        }
+        net::dispatch(ws_.get_executor(), [self = this->shared_from_this(), message = std::move(message)]() mutable {
+            self->Enqueue(std::move(message));
+        });
+        return true;
+    }
+
+    bool IsClosed() const noexcept override {
+        return closed_;
+    }
+
+    void Drain() override {
+        net::dispatch(ws_.get_executor(), [self = this->shared_from_this()] {
+            if (!self->closed_) {
+                self->Close(websocket::close_code::going_away);
+            }
+        });
+    }
+
+private:
+    // Клиент, не успевающий забирать сообщения, отключается: пропустить часть изменений
+    // состояния нельзя, а после переподключения клиент получит состояние целиком
+    static constexpr size_t MAX_QUEUE_SIZE = 64;
+
+    // Закрытое соединение перестаёт учитываться трекером сразу, а не при разрушении сессии:
+    // на неё ещё могут ссылаться подписчики, и остановка сервера ждала бы их
+    void Unregister() noexcept {
+        if (tracker_) {
+            tracker_->RemoveSession(tracker_key_);
+            tracker_ = nullptr;
+        }
+    }
+
+    void OnAccept(beast::error_code ec) {
+        using namespace std::literals;
+
+        if (ec) {
+            closed_ = true;
+            Unregister();
+            return ReportError(ec, "websocket accept"sv);
+        }
+        accepted_ = true;
+        if (closed_) {
+            // Клиент переполнил очередь ещё до завершения установки соединения
+            return Close(websocket::close_code::policy_error);
+        }
+        Read();
+        // Сообщения, поставленные в очередь до завершения установки соединения
+        if (!queue_.empty()) {
+            Write();
+        }
+    }
+
+    void Enqueue(Message message) {
+        if (closed_) {
+            return;
+        }
+        if (queue_.size() >= MAX_QUEUE_SIZE) {
+            return Close(websocket::close_code::policy_error);
+        }
+        queue_.push_back(std::move(message));
+        if (accepted_ && !writing_) {
+            Write();
+        }
+    }
+
+    void Read() {
+        // Сообщения клиента не используются, чтение нужно, чтобы обработать закрытие соединения
+        ws_.async_read(buffer_, beast::bind_front_handler(&WebSocketSession::OnRead, this->shared_from_this()));
+    }
+
+    void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+        using namespace std::literals;
+
+        if (ec) {
+            // Чтение завершается ошибкой, когда соединение закрыто любой из сторон.
+            // Если закрытие начал сервер, отмена чтения - не ошибка
+            const bool closing = closed_.exchange(true);
+            Unregister();
+            if (ec != websocket::error::closed && !(closing && ec == net::error::operation_aborted)) {
+                ReportError(ec, "websocket read"sv);
+            }
+            return;
+        }
+        buffer_.consume(buffer_.size());
+        Read();
+    }
+
+    void Write() {
+        writing_ = true;
+        ws_.text(true);
+        ws_.async_write(net::buffer(*queue_.front()),
+                        beast::bind_front_handler(&WebSocketSession::OnWrite, this->shared_from_this()));
+    }
+
+    void OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+        using namespace std::literals;
+
+        writing_ = false;
+        if (ec) {
+            closed_ = true;
+            return ReportError(ec, "websocket write"sv);
+        }
+        queue_.pop_front();
+        if (closed_) {
+            queue_.clear();
+            return;
+        }
+        if (!queue_.empty()) {
+            Write();
+        }
+    }
+
+    void Close(websocket::close_code code) {
+        using namespace std::literals;
+
+        closed_ = true;
+        if (!accepted_) {
+            return;
+        }
+        ws_.async_close(code, [self = this->shared_from_this()](beast::error_code ec) {
+            self->Unregister();
+            if (ec) {
+                ReportError(ec, "websocket close"sv);
+            }
+        });
+    }
+
+    websocket::stream<Stream> ws_;
+    beast::flat_buffer buffer_;
+    std::deque<Message> queue_;
+    bool accepted_ = false;
+    bool writing_ = false;
+    std::atomic<bool> closed_{false};
+    ConnectionTracker* tracker_;
+    ConnectionTracker::Key tracker_key_ = 0;
+};
+
+// HTTP-сессия поверх потока Stream (TcpStream или SslStream)
+template <typename Stream>
+class SessionBase : public ConnectionTracker::Drainable {
 public:
     SessionBase(const SessionBase&) = delete;
     SessionBase& operator=(const SessionBase&) = delete;
 
-    void Run();
+    void Run() {
+        if (services_.tracker) {
+            tracker_key_ = services_.tracker->AddSession(GetSharedThis());
+        }
+        net::dispatch(stream_.get_executor(), [self = GetSharedThis()] {
+            if constexpr (IS_SSL_STREAM<Stream>) {
+                self->Handshake();
+            } else {
+                self->Read();
+            }
+        });
+    }
 
 protected:
     using HttpRequest = http::request<http::string_body>;
 
-    explicit SessionBase(tcp::socket&& socket)
-        : stream_(std::move(socket)) {
+    SessionBase(Stream&& stream, const SessionServices& services)
+        : stream_(std::move(stream))
+        , services_(services)
+        , connection_id_(NextConnectionId()) {
+        if (IsTracingEnabled()) {
+            accepted_at_ = tracing::Clock::now();
+        }
     }
 
-    ~SessionBase() = default;
+    ~SessionBase() {
+        if (services_.tracker) {
+            // Запрос мог остаться без ответа, например, если соединение передано WebSocket-сессии
+            if (request_in_progress_) {
+                services_.tracker->OnRequestFinished();
+            }
+            services_.tracker->RemoveSession(tracker_key_);
+        }
+    }
+
+    ConnectionTracker* GetTracker() const noexcept {
+        return services_.tracker;
+    }
+
+    bool IsDraining() const noexcept {
+        return services_.tracker && services_.tracker->IsDraining();
+    }
+
+    // Трассируется ли текущий запрос
+    bool IsTraced() const noexcept {
+        return trace_id_ != 0;
+    }
+
+    // Записывает интервал трассы текущего запроса, если он трассируется
+    void RecordSpan(const char* name, tracing::Clock::time_point start) const noexcept {
+        RecordSpan(name, start, tracing::Clock::now());
+    }
+
+    // Записывает интервал, закончившийся в момент end. Интервал не записывается, если
+    // start или end не были засечены (трассировка включилась посреди соединения)
+    void RecordSpan(const char* name, tracing::Clock::time_point start, tracing::Clock::time_point end) const noexcept {
+        if (IsTraced() && start != tracing::Clock::time_point{} && end != tracing::Clock::time_point{}) {
+            services_.tracer->Record(name, trace_id_, start, end);
+        }
+    }
+
+    void Drain() override {
+        net::dispatch(GetExecutor(), [self = GetSharedThis()] {
+            // Простаивающую сессию закрываем сразу, остальные закроются после отправки ответа
+            if (!self->request_in_progress_) {
+                detail::Cancel(self->stream_);
+            }
+        });
+    }
+
+    // Исполнитель (strand), на котором выполняются операции сессии
+    auto GetExecutor() {
+        return stream_.get_executor();
+    }
+
+    // Забирает поток для WebSocket-сессии. После этого HTTP-сессия больше не читает запросы
+    Stream ReleaseStream() {
+        return std::move(stream_);
+    }
 
     template <typename Body, typename Fields>
     void Write(http::response<Body, Fields>&& response) {
         auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
 
+        if (services_.recorder) {
+            if constexpr (std::is_same_v<Body, http::string_body>) {
+                services_.recorder->RecordResponse(connection_id_, request_index_, safe_response->result_int(),
+                                                   safe_response->body());
+            } else if constexpr (std::is_same_v<Body, SharedStringBody>) {
+                const auto& body = safe_response->body();
+                services_.recorder->RecordResponse(connection_id_, request_index_, safe_response->result_int(),
+                                                   body ? std::string_view{*body} : std::string_view{});
+            }
+        }
+
+        // При остановке сервера просим клиента закрыть соединение после этого ответа
+        if (IsDraining()) {
+            safe_response->keep_alive(false);
+        }
+
+        if (IsTraced()) {
+            write_started_at_ = tracing::Clock::now();
+        }
         auto self = GetSharedThis();
         http::async_write(stream_, *safe_response,
                           [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
@@ -52,36 +548,198 @@ protected:
     }
 
 private:
-    void Read();
-    void OnRead(beast::error_code ec, std::size_t bytes_read);
-    void OnWrite(bool close, beast::error_code ec, std::size_t bytes_written);
-    void Close();
+    bool IsTracingEnabled() const noexcept {
+        return services_.tracer && services_.tracer->GetSampleEvery() != 0;
+    }
+
+    void Handshake() {
+        using namespace std::literals;
+        detail::ExpiresAfter(stream_, 30s);
+        stream_.async_handshake(ssl::stream_base::server,
+                                beast::bind_front_handler(&SessionBase::OnHandshake, GetSharedThis()));
+    }
+
+    void OnHandshake(beast::error_code ec) {
+        using namespace std::literals;
+        if (ec) {
+            if (ec == net::error::operation_aborted && IsDraining()) {
+                return;
+            }
+            return ReportError(ec, "handshake"sv);
+        }
+        Read();
+    }
+
+    void Read() {
+        using namespace std::literals;
+        if (IsDraining()) {
+            return Close();
+        }
+        request_ = {};
+        detail::ExpiresAfter(stream_, 30s);
+
+        // Решение о трассировке принимается, когда запрос прочитан, поэтому время начала чтения
+        // запоминаем, пока трассировка включена. В чтение входит ожидание запроса на keep-alive соединении
+        if (IsTracingEnabled()) {
+            read_started_at_ = tracing::Clock::now();
+        }
+
+        http::async_read(stream_, buffer_, request_,
+                         beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis()));
+    }
+
+    void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+        using namespace std::literals;
+
+        if (ec == http::error::end_of_stream) {
+            return Close();
+        }
+        if (ec == net::error::operation_aborted && IsDraining()) {
+            // Чтение прервано из-за остановки сервера
+            return Close();
+        }
+        if (ec) {
+            return ReportError(ec, "read"sv);
+        }
+        if (services_.tracker) {
+            request_in_progress_ = true;
+            services_.tracker->OnRequestStarted();
+        }
+        if (services_.recorder) {
+            ++request_index_;
+            services_.recorder->RecordRequest(connection_id_, request_index_, request_);
+        }
+        if (services_.tracer) {
+            trace_id_ = services_.tracer->StartTrace();
+            // Интервал accept - от принятия соединения (включая TLS-рукопожатие) до начала чтения
+            // первого запроса. Он заканчивается там, где начинается read, чтобы время чтения не учитывалось дважды
+            RecordSpan("accept", std::exchange(accepted_at_, {}), read_started_at_);
+            RecordSpan("read", std::exchange(read_started_at_, {}));
+        }
+        // Исключение из обработчика не должно завершать рабочий поток io_context:
+        // отвечаем клиенту ошибкой сервера и закрываем соединение
+        const unsigned version = request_.version();
+        try {
+            if (websocket::is_upgrade(request_)) {
+                return HandleUpgrade(std::move(request_));
+            }
+            // Интервал handler - синхронная часть обработчика. Интервалы, записанные
+            // обработчиком с помощью tracing::ScopedSpan, относятся к трассе этого запроса
+            const auto handler_started_at = IsTraced() ? tracing::Clock::now() : tracing::Clock::time_point{};
+            tracing::TraceScope trace_scope{{services_.tracer, trace_id_}};
+            HandleRequest(std::move(request_));
+            RecordSpan("handler", handler_started_at);
+        } catch (const std::exception& ex) {
+            std::cerr << "request handler: "sv << ex.what() << std::endl;
+            StringResponse response{http::status::internal_server_error, version};
+            response.set(http::field::content_type, "text/plain"sv);
+            response.body() = "Internal server error"sv;
+            response.keep_alive(false);
+            response.prepare_payload();
+            Write(std::move(response));
+        }
+    }
+
+    void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+        using namespace std::literals;
+
+        if (request_in_progress_) {
+            request_in_progress_ = false;
+            services_.tracker->OnRequestFinished();
+        }
+        RecordSpan("write", write_started_at_);
+        trace_id_ = 0;
+
+        if (ec) {
+            return ReportError(ec, "write"sv);
+        }
+
+        if (close) {
+            return Close();
+        }
+
+        Read();
+    }
+
+    void Close() {
+        using namespace std::literals;
+
+        if constexpr (IS_SSL_STREAM<Stream>) {
+            detail::ExpiresAfter(stream_, 30s);
+            stream_.async_shutdown([self = GetSharedThis()](beast::error_code ec) {
+                if (ec && ec != net::error::eof && ec != ssl::error::stream_truncated) {
+                    ReportError(ec, "ssl shutdown"sv);
+                }
+            });
+        } else {
+            beast::error_code ec;
+            detail::ShutdownSend(stream_, ec);
+            if (ec) {
+                ReportError(ec, "socket shutdown"sv);
+            }
+        }
+    }
 
     virtual void HandleRequest(HttpRequest&& request) = 0;
+    virtual void HandleUpgrade(HttpRequest&& request) = 0;
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
 
-    beast::tcp_stream stream_;
+    Stream stream_;
     beast::flat_buffer buffer_;
     HttpRequest request_;
+
+    SessionServices services_;
+    ConnectionTracker::Key tracker_key_ = 0;
+    // Запрос прочитан, а ответ на него ещё не отправлен
+    bool request_in_progress_ = false;
+    // Идентификатор трассы текущего запроса или 0, если запрос не трассируется
+    std::uint64_t trace_id_ = 0;
+    tracing::Clock::time_point accepted_at_;
+    tracing::Clock::time_point read_started_at_;
+    tracing::Clock::time_point write_started_at_;
+    // Номер соединения и номер текущего запроса в нём, используются при записи трафика
+    std::uint64_t connection_id_;
+    std::uint64_t request_index_ = 0;
 };
 
-template <typename RequestHandler>
-class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
+template <typename Stream, typename RequestHandler>
+class Session : public SessionBase<Stream>, public std::enable_shared_from_this<Session<Stream, RequestHandler>> {
 public:
     template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler)
-        : SessionBase(std::move(socket))
+    Session(Stream&& stream, Handler&& request_handler, const SessionServices& services)
+        : SessionBase<Stream>(std::move(stream), services)
         , request_handler_(std::forward<Handler>(request_handler)) {
     }
 
 private:
+    using typename SessionBase<Stream>::HttpRequest;
+
     void HandleRequest(HttpRequest&& request) override {
-        request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
-            self->Write(std::move(response));
+        request_handler_(std::move(request), MakeSender(), WebSocketAccept{});
+    }
+
+    void HandleUpgrade(HttpRequest&& request) override {
+        // Обработчик либо принимает соединение, вызвав accept, либо отвечает обычным HTTP-ответом
+        request_handler_(std::move(request), MakeSender(), [self = this->shared_from_this()] {
+            return std::make_shared<WebSocketSession<Stream>>(self->ReleaseStream(), self->GetTracker());
         });
     }
 
-    std::shared_ptr<SessionBase> GetSharedThis() override {
+    auto MakeSender() {
+        return [self = this->shared_from_this()](auto&& response) {
+            // Ответ может быть сформирован на strand игрового сеанса,
+            // поэтому запись в сокет выполняем на strand сессии.
+            // Интервал dispatch - ожидание strand сессии
+            const auto sent_at = self->IsTraced() ? tracing::Clock::now() : tracing::Clock::time_point{};
+            net::dispatch(self->GetExecutor(),
+                          [self, response = std::move(response), sent_at]() mutable {
+                              self->RecordSpan("dispatch", sent_at);
+                              self->Write(std::move(response));
+                          });
+        };
+    }
+
+    std::shared_ptr<SessionBase<Stream>> GetSharedThis() override {
         return this->shared_from_this();
     }
 
@@ -89,23 +747,42 @@ private:
 };
 
 template <typename RequestHandler>
-class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
+class Listener : public ConnectionTracker::Drainable, public std::enable_shared_from_this<Listener<RequestHandler>> {
 public:
+    // Если задан ssl_context, соединения принимаются по TLS
     template <typename Handler>
-    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler,
+             const SessionServices& services, std::shared_ptr<ssl::context> ssl_context)
         : ioc_(ioc)
         , acceptor_(net::make_strand(ioc))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , services_(services)
+        , ssl_context_(std::move(ssl_context)) {
         acceptor_.open(endpoint.protocol());
         acceptor_.set_option(net::socket_base::reuse_address(true));
+        if (endpoint.address().is_v6()) {
+            // IPv6-адрес слушаем только по IPv6, чтобы на тот же порт можно было отдельно повесить IPv4
+            acceptor_.set_option(net::ip::v6_only(true));
+        }
         acceptor_.bind(endpoint);
         acceptor_.listen(net::socket_base::max_listen_connections);
     }
 
     void Run() {
+        if (services_.tracker) {
+            services_.tracker->AddListener(this->weak_from_this());
+        }
         DoAccept();
     }
 
+    // Перестаёт принимать новые соединения
+    void Drain() override {
+        net::dispatch(acceptor_.get_executor(), [self = this->shared_from_this()] {
+            beast::error_code ec;
+            self->acceptor_.close(ec);
+        });
+    }
+
 private:
     void DoAccept() {
         acceptor_.async_accept(
@@ -116,6 +793,9 @@ private:
     void OnAccept(sys::error_code ec, tcp::socket socket) {
         using namespace std::literals;
 
+        if (ec == net::error::operation_aborted && services_.tracker && services_.tracker->IsDraining()) {
+            return;
+        }
         if (ec) {
             return ReportError(ec, "accept"sv);
         }
@@ -125,18 +805,32 @@ private:
     }
 
     void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+        if (ssl_context_) {
+            using SslSession = Session<SslStream, RequestHandler>;
+            std::make_shared<SslSession>(SslStream(std::move(socket), *ssl_context_), request_handler_, services_)
+                ->Run();
+        } else {
+            using TcpSession = Session<TcpStream, RequestHandler>;
+            std::make_shared<TcpSession>(TcpStream(std::move(socket)), request_handler_, services_)->Run();
+        }
     }
 
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     RequestHandler request_handler_;
+    SessionServices services_;
+    std::shared_ptr<ssl::context> ssl_context_;
 };
 
+// services задаёт общие службы сессий (запись трафика, учёт соединений).
+// Если задан ssl_context, соединения принимаются по TLS
 template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler,
+               const SessionServices& services = {}, std::shared_ptr<ssl::context> ssl_context = nullptr) {
     using MyListener = Listener<std::decay_t<RequestHandler>>;
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), services,
+                                 std::move(ssl_context))
+        ->Run();
 }
 
 }  // namespace http_server
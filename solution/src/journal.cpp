@@ -0,0 +1,350 @@
+#include "journal.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+#include "binary_io.h"
+#include "snapshot.h"
+
+namespace persistence {
+using namespace std::literals;
+
+namespace {
+
+constexpr std::uint8_t JOIN_GAME_RECORD = 1;
+constexpr size_t RECORD_HEADER_SIZE = sizeof(std::uint32_t) * 2;
+
+std::uint32_t CalcChecksum(std::string_view data) noexcept {
+    std::uint32_t hash = 2166136261u;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void ReportError(std::string_view what, int error) {
+    std::cerr << "Journal: "sv << what << ": "sv << std::strerror(error) << std::endl;
+}
+
+}  // namespace
+
+Journal::Journal(std::filesystem::path path, std::chrono::milliseconds commit_interval, size_t commit_batch)
+    : path_{std::move(path)}
+    , commit_interval_{commit_interval}
+    , commit_batch_{std::max<size_t>(1, commit_batch)} {
+    // Новые записи всегда пишем в новый сегмент, старые остаются для восстановления
+    const auto segments = ListSegments();
+    last_segment_ = segments.empty() ? 1 : segments.back() + 1;
+    OpenSegment(last_segment_);
+
+    thread_ = std::jthread{[this](std::stop_token stop_token) {
+        Run(stop_token);
+    }};
+}
+
+Journal::~Journal() {
+    Stop();
+}
+
+std::filesystem::path Journal::GetSegmentPath(std::uint64_t segment) const {
+    std::filesystem::path segment_path = path_;
+    segment_path += "." + std::to_string(segment);
+    return segment_path;
+}
+
+std::vector<std::uint64_t> Journal::ListSegments() const {
+    std::vector<std::uint64_t> segments;
+    const auto dir = path_.has_parent_path() ? path_.parent_path() : std::filesystem::path{"."};
+    const std::string prefix = path_.filename().string() + ".";
+
+    std::error_code ec;
+    for (const auto& dir_entry : std::filesystem::directory_iterator{dir, ec}) {
+        const std::string name = dir_entry.path().filename().string();
+        if (!name.starts_with(prefix) || name.size() == prefix.size()) {
+            continue;
+        }
+        const std::string_view suffix = std::string_view{name}.substr(prefix.size());
+        if (!std::all_of(suffix.begin(), suffix.end(), [](char c) {
+                return c >= '0' && c <= '9';
+            })) {
+            continue;
+        }
+        segments.push_back(std::stoull(std::string{suffix}));
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+app::GameState Journal::Replay() const {
+    app::GameState state;
+    for (const std::uint64_t segment : ListSegments()) {
+        const auto segment_path = GetSegmentPath(segment);
+        std::ifstream file(segment_path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        const std::string data = buffer.str();
+
+        binary_io::BinaryReader reader{data};
+        while (!reader.IsEnd()) {
+            if (data.size() - reader.GetPosition() < RECORD_HEADER_SIZE) {
+                std::cerr << "Journal: truncated record in "sv << segment_path << std::endl;
+                break;
+            }
+            const auto payload_size = reader.Read<std::uint32_t>();
+            const auto checksum = reader.Read<std::uint32_t>();
+            if (data.size() - reader.GetPosition() < payload_size) {
+                std::cerr << "Journal: truncated record in "sv << segment_path << std::endl;
+                break;
+            }
+            const auto payload = reader.ReadBytes(payload_size);
+            if (CalcChecksum(payload) != checksum) {
+                std::cerr << "Journal: corrupted record in "sv << segment_path << std::endl;
+                break;
+            }
+
+            // Запись с верной контрольной суммой, но недопустимым содержимым (например, слишком
+            // длинным id карты) не должна прерывать запуск: как и повреждённая запись, она завершает сегмент
+            try {
+                binary_io::BinaryReader payload_reader{payload};
+                if (payload_reader.Read<std::uint8_t>() == JOIN_GAME_RECORD) {
+                    state.players.push_back(DeserializePlayerState(payload_reader));
+                }
+            } catch (const std::exception& ex) {
+                std::cerr << "Journal: invalid record in "sv << segment_path << ": "sv << ex.what() << std::endl;
+                break;
+            }
+        }
+    }
+    return state;
+}
+
+void Journal::OnJoinGame(const app::PlayerState& player, CommitHandler on_commit) {
+    // Сериализуем запись в вызывающем потоке, поток журнала только пишет байты
+    binary_io::BinaryWriter payload;
+    payload.Write(JOIN_GAME_RECORD);
+    SerializePlayerState(payload, player);
+
+    binary_io::BinaryWriter record;
+    record.Write(static_cast<std::uint32_t>(payload.GetBuffer().size()));
+    record.Write(CalcChecksum(payload.GetBuffer()));
+    record.WriteBytes(payload.GetBuffer());
+
+    Enqueue({Entry::Kind::RECORD, std::move(record.GetBuffer()), std::move(on_commit), 0, Clock::now()});
+}
+
+std::uint64_t Journal::Rotate(RotatedHandler on_rotated) {
+    std::lock_guard lock{mutex_};
+    const std::uint64_t segment = ++last_segment_;
+    queue_.push_back({Entry::Kind::ROTATE, {}, {}, segment, Clock::now(), std::move(on_rotated)});
+    cv_.notify_one();
+    return segment;
+}
+
+void Journal::RemoveSegmentsBefore(std::uint64_t segment) {
+    Enqueue({Entry::Kind::REMOVE_BEFORE, {}, {}, segment, Clock::now()});
+}
+
+void Journal::Enqueue(Entry entry) {
+    {
+        std::lock_guard lock{mutex_};
+        queue_.push_back(std::move(entry));
+    }
+    cv_.notify_one();
+}
+
+void Journal::Stop() {
+    if (thread_.joinable()) {
+        thread_.request_stop();
+        thread_.join();
+    }
+}
+
+void Journal::Run(std::stop_token stop_token) {
+    for (;;) {
+        std::vector<Entry> batch;
+        {
+            std::unique_lock lock{mutex_};
+            // При остановке дописываем всё, что осталось в очереди
+            if (!cv_.wait(lock, stop_token, [this] {
+                    return !queue_.empty();
+                })) {
+                break;
+            }
+            // Ждём, пока наберётся группа или истечёт интервал с момента первой записи группы
+            const auto deadline = queue_.front().enqueue_time + commit_interval_;
+            cv_.wait_until(lock, stop_token, deadline, [this] {
+                return queue_.size() >= commit_batch_;
+            });
+            batch.swap(queue_);
+        }
+        ProcessBatch(batch);
+    }
+    CloseSegment();
+
+    if (commits_ > 0) {
+        using namespace std::chrono;
+        std::cout << "Journal: records="sv << committed_records_ << " commits="sv << commits_
+                  << " avg_batch="sv << committed_records_ / commits_
+                  << " avg_commit_latency_us="sv << duration_cast<microseconds>(total_commit_latency_).count() / committed_records_
+                  << " max_commit_latency_us="sv << duration_cast<microseconds>(max_commit_latency_).count() << std::endl;
+    }
+    if (failed_records_ > 0) {
+        std::cerr << "Journal: failed_records="sv << failed_records_ << std::endl;
+    }
+}
+
+void Journal::ProcessBatch(std::vector<Entry>& batch) {
+    std::string pending_data;
+    for (auto& entry : batch) {
+        switch (entry.kind) {
+            case Entry::Kind::RECORD:
+                pending_data += entry.data;
+                pending_commits_.push_back(std::move(entry.on_commit));
+                pending_enqueue_times_.push_back(entry.enqueue_time);
+                break;
+            case Entry::Kind::ROTATE:
+                Flush(pending_data);
+                CloseSegment();
+                try {
+                    OpenSegment(entry.segment);
+                } catch (const std::system_error& ex) {
+                    ReportError("rotate"sv, ex.code().value());
+                }
+                if (entry.on_rotated) {
+                    entry.on_rotated(entry.segment);
+                }
+                break;
+            case Entry::Kind::REMOVE_BEFORE:
+                for (const std::uint64_t segment : ListSegments()) {
+                    if (segment < entry.segment) {
+                        std::error_code ec;
+                        std::filesystem::remove(GetSegmentPath(segment), ec);
+                    }
+                }
+                break;
+        }
+    }
+    Flush(pending_data);
+}
+
+void Journal::Flush(std::string& pending_data) {
+    if (pending_commits_.empty()) {
+        return;
+    }
+
+    const bool committed = EnsureSegmentOpen() && WriteAndSync(pending_data);
+    if (committed) {
+        segment_size_ += pending_data.size();
+
+        const auto commit_time = Clock::now();
+        for (const auto enqueue_time : pending_enqueue_times_) {
+            const auto latency = commit_time - enqueue_time;
+            total_commit_latency_ += latency;
+            max_commit_latency_ = std::max(max_commit_latency_, latency);
+        }
+        committed_records_ += pending_commits_.size();
+        ++commits_;
+    } else {
+        failed_records_ += pending_commits_.size();
+        AbandonSegment();
+    }
+
+    for (auto& on_commit : pending_commits_) {
+        on_commit(committed);
+    }
+    pending_commits_.clear();
+    pending_enqueue_times_.clear();
+    pending_data.clear();
+}
+
+bool Journal::EnsureSegmentOpen() {
+    if (fd_ >= 0) {
+        return true;
+    }
+    try {
+        OpenSegment(AllocateSegment());
+        return true;
+    } catch (const std::system_error& ex) {
+        ReportError("open segment"sv, ex.code().value());
+        return false;
+    }
+}
+
+bool Journal::WriteAndSync(std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = ::write(fd_, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ReportError("write"sv, errno);
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    // Один fdatasync на всю группу записей
+    if (::fdatasync(fd_) != 0) {
+        ReportError("fdatasync"sv, errno);
+        return false;
+    }
+    return true;
+}
+
+void Journal::AbandonSegment() {
+    if (fd_ < 0) {
+        return;
+    }
+    // Обрезаем недописанную группу, чтобы чтение сегмента не останавливалось на ней
+    // раньше последней подтверждённой записи
+    if (::ftruncate(fd_, static_cast<off_t>(segment_size_)) != 0 || ::fdatasync(fd_) != 0) {
+        ReportError("truncate"sv, errno);
+    }
+    CloseSegment();
+}
+
+std::uint64_t Journal::AllocateSegment() {
+    std::lock_guard lock{mutex_};
+    return ++last_segment_;
+}
+
+void Journal::OpenSegment(std::uint64_t segment) {
+    const auto segment_path = GetSegmentPath(segment);
+    const int fd = ::open(segment_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + segment_path.string());
+    }
+    struct stat file_stat {};
+    if (::fstat(fd, &file_stat) != 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Failed to stat " + segment_path.string());
+    }
+    // Новый сегмент должен пережить сбой вместе с записями, подтверждёнными в нём
+    try {
+        SyncDirectory(segment_path.parent_path());
+    } catch (const std::system_error&) {
+        ::close(fd);
+        throw;
+    }
+    fd_ = fd;
+    segment_size_ = static_cast<std::uint64_t>(file_stat.st_size);
+}
+
+void Journal::CloseSegment() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+}  // namespace persistence
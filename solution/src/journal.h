@@ -0,0 +1,125 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application.h"
+
+namespace persistence {
+
+/*
+ * Журнал действий игроков (write-ahead log).
+ *
+ * Журнал состоит из сегментов <path>.<номер>. Каждая запись сегмента:
+ *
+ *  uint32  payload_size
+ *  uint32  checksum       (FNV-1a от payload)
+ *  payload:
+ *      uint8        type  (1 - вход игрока)
+ *      PlayerState        (формат описан в snapshot.h)
+ *
+ * Запись с неверной длиной или контрольной суммой считается оборванной при сбое:
+ * чтение сегмента на ней прекращается.
+ *
+ * Записи накапливаются и сбрасываются на диск группами (group commit) в отдельном потоке:
+ * когда набирается commit_batch записей или проходит commit_interval с момента первой
+ * записи группы. После fdatasync вызываются обработчики подтверждения всех записей группы.
+ *
+ * Если записать группу или сбросить её на диск не удалось, её обработчики вызываются
+ * с committed = false. Недописанный хвост группы обрезается до последней сохранённой записи,
+ * а следующие записи идут в новый сегмент: после ошибки fdatasync содержимому текущего
+ * сегмента в кэше доверять нельзя.
+ *
+ * Перед созданием снимка журнал переключается на новый сегмент (Rotate). Состояние для снимка
+ * собирается, когда все записи предыдущих сегментов подтверждены или отклонены: тогда в снимок
+ * попадают все сохранённые в них действия, и после записи снимка эти сегменты можно удалить
+ * (RemoveSegmentsBefore).
+ */
+class Journal : public app::ActionListener {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Получает номер нового сегмента
+    using RotatedHandler = std::function<void(std::uint64_t segment)>;
+
+    Journal(std::filesystem::path path, std::chrono::milliseconds commit_interval, size_t commit_batch);
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    ~Journal();
+
+    // Читает все сегменты журнала по порядку. Вызывается до начала записи
+    app::GameState Replay() const;
+
+    void OnJoinGame(const app::PlayerState& player, CommitHandler on_commit) override;
+
+    // Начинает новый сегмент. Возвращает его номер.
+    // on_rotated вызывается в потоке журнала, когда обработчики подтверждения всех записей,
+    // добавленных до Rotate, уже вызваны
+    std::uint64_t Rotate(RotatedHandler on_rotated = {});
+
+    // Удаляет сегменты с номерами меньше segment
+    void RemoveSegmentsBefore(std::uint64_t segment);
+
+    // Сбрасывает на диск накопленные записи и останавливает поток
+    void Stop();
+
+private:
+    struct Entry {
+        enum class Kind { RECORD, ROTATE, REMOVE_BEFORE };
+
+        Kind kind;
+        std::string data;
+        CommitHandler on_commit;
+        std::uint64_t segment = 0;
+        Clock::time_point enqueue_time;
+        RotatedHandler on_rotated;
+    };
+
+    void Enqueue(Entry entry);
+    void Run(std::stop_token stop_token);
+    void ProcessBatch(std::vector<Entry>& batch);
+    void Flush(std::string& pending_data);
+    bool EnsureSegmentOpen();
+    bool WriteAndSync(std::string_view data);
+    void AbandonSegment();
+    std::uint64_t AllocateSegment();
+    void OpenSegment(std::uint64_t segment);
+    void CloseSegment();
+    std::filesystem::path GetSegmentPath(std::uint64_t segment) const;
+    std::vector<std::uint64_t> ListSegments() const;
+
+    std::filesystem::path path_;
+    std::chrono::milliseconds commit_interval_;
+    size_t commit_batch_;
+
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::vector<Entry> queue_;
+    std::uint64_t last_segment_ = 0;
+
+    // Используются только потоком журнала
+    int fd_ = -1;
+    // Размер сегмента, включающий только сохранённые на диске записи
+    std::uint64_t segment_size_ = 0;
+    std::vector<CommitHandler> pending_commits_;
+    std::vector<Clock::time_point> pending_enqueue_times_;
+
+    // Статистика group commit
+    std::uint64_t committed_records_ = 0;
+    std::uint64_t commits_ = 0;
+    std::uint64_t failed_records_ = 0;
+    Clock::duration total_commit_latency_{};
+    Clock::duration max_commit_latency_{};
+
+    std::jthread thread_;
+};
+
+}  // namespace persistence
@@ -1,7 +1,11 @@
 #include "json_loader.h"
 #include <boost/json.hpp>
 #include <fstream>
+#include <limits>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace json = boost::json;
 
@@ -30,86 +34,211 @@ namespace {
     
     using model::Coord;
     using model::Dimension;
+    using namespace std::literals;
+    
+    // Ошибка в содержимом конфигурационного файла
+    class ConfigError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+    
+    // Идентификаторы карт и офисов хранятся в строках фиксированной длины
+    model::IdString MakeIdString(std::string_view id) {
+        if (!model::IdString::Fits(id)) {
+            throw ConfigError("Id \""s + std::string(id) + "\" is longer than "s
+                              + std::to_string(model::IdString::CAPACITY) + " characters"s);
+        }
+        return model::IdString{id};
+    }
+    
+    // Функции доступа к значениям JSON выбрасывают ConfigError с понятным описанием,
+    // а не исключения boost::json вроде "out of range"
+    const json::object& AsObject(const json::value& value, std::string_view what) {
+        if (const auto* obj = value.if_object()) {
+            return *obj;
+        }
+        throw ConfigError(std::string(what) + " must be an object"s);
+    }
+    
+    const json::value& GetValue(const json::object& obj, std::string_view key) {
+        if (const auto* value = obj.if_contains(key)) {
+            return *value;
+        }
+        throw ConfigError("Missing key \""s + std::string(key) + "\""s);
+    }
+    
+    const json::array& GetArray(const json::object& obj, std::string_view key) {
+        if (const auto* arr = GetValue(obj, key).if_array()) {
+            return *arr;
+        }
+        throw ConfigError("\""s + std::string(key) + "\" must be an array"s);
+    }
+    
+    std::string GetString(const json::object& obj, std::string_view key) {
+        if (const auto* str = GetValue(obj, key).if_string()) {
+            return std::string(*str);
+        }
+        throw ConfigError("\""s + std::string(key) + "\" must be a string"s);
+    }
+    
+    // Целое значение, помещающееся в тип Int. Как и value_to<Int>, принимает числа
+    // с плавающей точкой без дробной части (10.0), но отвергает дробные (10.5)
+    template <typename Int>
+    Int GetInt(const json::object& obj, std::string_view key) {
+        const auto& value = GetValue(obj, key);
+        if (value.is_number()) {
+            boost::system::error_code ec;
+            const auto result = value.to_number<Int>(ec);
+            if (!ec) {
+                return result;
+            }
+        }
+        throw ConfigError("\""s + std::string(key) + "\" must be an integer in range ["s
+                          + std::to_string(std::numeric_limits<Int>::min()) + ", "s
+                          + std::to_string(std::numeric_limits<Int>::max()) + "]"s);
+    }
+    
+    // Выполняет parse, дополняя сообщение об ошибке описанием того, что разбиралось
+    template <typename Fn>
+    void WithContext(std::string_view context, Fn&& parse) {
+        try {
+            parse();
+        } catch (const ConfigError& ex) {
+            throw ConfigError(std::string(context) + ": "s + ex.what());
+        }
+    }
     
     // Метод для парсинга дорог
     void ParseRoads(const json::array& roads_array, model::Map& map) {
-        for (const auto& road_value : roads_array) {
-            const auto& road_obj = road_value.as_object();
-            
-            Coord x0 = json::value_to<Coord>(road_obj.at(X0_KEY));
-            Coord y0 = json::value_to<Coord>(road_obj.at(Y0_KEY));
-            model::Point start{x0, y0};
-            
-            if (road_obj.contains(X1_KEY)) {
-                // Горизонтальная дорога
-                Coord x1 = json::value_to<Coord>(road_obj.at(X1_KEY));
-                map.AddRoad(model::Road(model::Road::HORIZONTAL, start, x1));
-            } else if (road_obj.contains(Y1_KEY)) {
-                // Вертикальная дорога
-                Coord y1 = json::value_to<Coord>(road_obj.at(Y1_KEY));
-                map.AddRoad(model::Road(model::Road::VERTICAL, start, y1));
-            }
+        for (size_t i = 0; i < roads_array.size(); ++i) {
+            WithContext("road #"s + std::to_string(i), [&] {
+                const auto& road_obj = AsObject(roads_array[i], "Road"sv);
+                
+                Coord x0 = GetInt<Coord>(road_obj, X0_KEY);
+                Coord y0 = GetInt<Coord>(road_obj, Y0_KEY);
+                model::Point start{x0, y0};
+                
+                if (road_obj.contains(X1_KEY)) {
+                    // Горизонтальная дорога
+                    Coord x1 = GetInt<Coord>(road_obj, X1_KEY);
+                    map.AddRoad(model::Road(model::Road::HORIZONTAL, start, x1));
+                } else if (road_obj.contains(Y1_KEY)) {
+                    // Вертикальная дорога
+                    Coord y1 = GetInt<Coord>(road_obj, Y1_KEY);
+                    map.AddRoad(model::Road(model::Road::VERTICAL, start, y1));
+                } else {
+                    throw ConfigError("Road must have either \"x1\" or \"y1\""s);
+                }
+            });
         }
     }
     
     // Метод для парсинга зданий
     void ParseBuildings(const json::array& buildings_array, model::Map& map) {
-        for (const auto& building_value : buildings_array) {
-            const auto& building_obj = building_value.as_object();
-            
-            Coord x = json::value_to<Coord>(building_obj.at(X_KEY));
-            Coord y = json::value_to<Coord>(building_obj.at(Y_KEY));
-            Dimension w = json::value_to<Dimension>(building_obj.at(W_KEY));
-            Dimension h = json::value_to<Dimension>(building_obj.at(H_KEY));
-            
-            model::Rectangle bounds{{x, y}, {w, h}};
-            map.AddBuilding(model::Building(bounds));
+        for (size_t i = 0; i < buildings_array.size(); ++i) {
+            WithContext("building #"s + std::to_string(i), [&] {
+                const auto& building_obj = AsObject(buildings_array[i], "Building"sv);
+                
+                Coord x = GetInt<Coord>(building_obj, X_KEY);
+                Coord y = GetInt<Coord>(building_obj, Y_KEY);
+                Dimension w = GetInt<Dimension>(building_obj, W_KEY);
+                Dimension h = GetInt<Dimension>(building_obj, H_KEY);
+                
+                model::Rectangle bounds{{x, y}, {w, h}};
+                map.AddBuilding(model::Building(bounds));
+            });
         }
     }
     
     // Метод для парсинга офисов
     void ParseOffices(const json::array& offices_array, model::Map& map) {
-        for (const auto& office_value : offices_array) {
-            const auto& office_obj = office_value.as_object();
-            
-            std::string office_id_str = json::value_to<std::string>(office_obj.at(ID_KEY));
-            Coord x = json::value_to<Coord>(office_obj.at(X_KEY));
-            Coord y = json::value_to<Coord>(office_obj.at(Y_KEY));
-            Dimension offsetX = json::value_to<Dimension>(office_obj.at(OFFSET_X_KEY));
-            Dimension offsetY = json::value_to<Dimension>(office_obj.at(OFFSET_Y_KEY));
-            
-            model::Office::Id office_id{std::move(office_id_str)};
-            model::Point position{x, y};
-            model::Offset offset{offsetX, offsetY};
-            
-            map.AddOffice(model::Office(std::move(office_id), position, offset));
+        for (size_t i = 0; i < offices_array.size(); ++i) {
+            WithContext("office #"s + std::to_string(i), [&] {
+                const auto& office_obj = AsObject(offices_array[i], "Office"sv);
+                
+                std::string office_id_str = GetString(office_obj, ID_KEY);
+                Coord x = GetInt<Coord>(office_obj, X_KEY);
+                Coord y = GetInt<Coord>(office_obj, Y_KEY);
+                Dimension offsetX = GetInt<Dimension>(office_obj, OFFSET_X_KEY);
+                Dimension offsetY = GetInt<Dimension>(office_obj, OFFSET_Y_KEY);
+                
+                model::Office::Id office_id{MakeIdString(office_id_str)};
+                model::Point position{x, y};
+                model::Offset offset{offsetX, offsetY};
+                
+                try {
+                    map.AddOffice(model::Office(std::move(office_id), position, offset));
+                } catch (const std::invalid_argument& ex) {
+                    throw ConfigError(ex.what());
+                }
+            });
         }
     }
     
     // Метод для парсинга карты
     model::Map ParseMap(const json::object& map_obj) {
         // Получаем id и name карты
-        std::string id_str = json::value_to<std::string>(map_obj.at(ID_KEY));
-        std::string name = json::value_to<std::string>(map_obj.at(NAME_KEY));
-        
-        // Создаем карту
-        model::Map::Id map_id{std::move(id_str)};
-        model::Map map(std::move(map_id), std::move(name));
+        std::string id_str = GetString(map_obj, ID_KEY);
+        if (id_str.empty()) {
+            throw ConfigError("Map id must not be empty"s);
+        }
         
-        // Обрабатываем дороги
-        ParseRoads(map_obj.at(ROADS_KEY).as_array(), map);
+        std::optional<model::Map> map;
+        WithContext("map \""s + id_str + "\""s, [&] {
+            std::string name = GetString(map_obj, NAME_KEY);
+            
+            // Создаем карту
+            model::Map::Id map_id{MakeIdString(id_str)};
+            map.emplace(std::move(map_id), std::move(name));
+            
+            // Обрабатываем дороги
+            ParseRoads(GetArray(map_obj, ROADS_KEY), *map);
+            
+            // Обрабатываем здания (если есть)
+            if (map_obj.contains(BUILDINGS_KEY)) {
+                ParseBuildings(GetArray(map_obj, BUILDINGS_KEY), *map);
+            }
+            
+            // Обрабатываем офисы (если есть)
+            if (map_obj.contains(OFFICES_KEY)) {
+                ParseOffices(GetArray(map_obj, OFFICES_KEY), *map);
+            }
+        });
         
-        // Обрабатываем здания (если есть)
-        if (map_obj.contains(BUILDINGS_KEY)) {
-            ParseBuildings(map_obj.at(BUILDINGS_KEY).as_array(), map);
+        return std::move(*map);
+    }
+    
+    // source описывает источник конфигурации в сообщениях об ошибках
+    model::Game ParseGameConfig(std::string_view json_text, std::string_view source) {
+        // Распарсить строку как JSON
+        boost::system::error_code ec;
+        auto value = json::parse(json_text, ec);
+        if (ec) {
+            throw std::runtime_error("Failed to parse "s + std::string(source) + ": "s + ec.message());
         }
         
-        // Обрабатываем офисы (если есть)
-        if (map_obj.contains(OFFICES_KEY)) {
-            ParseOffices(map_obj.at(OFFICES_KEY).as_array(), map);
+        model::Game game;
+        
+        try {
+            const auto& root = AsObject(value, "Config root"sv);
+            
+            // Обрабатываем массив карт
+            const auto& maps_array = GetArray(root, MAPS_KEY);
+            for (size_t i = 0; i < maps_array.size(); ++i) {
+                WithContext("map #"s + std::to_string(i), [&] {
+                    model::Map map = ParseMap(AsObject(maps_array[i], "Map"sv));
+                    try {
+                        game.AddMap(std::move(map));
+                    } catch (const std::invalid_argument& ex) {
+                        throw ConfigError(ex.what());
+                    }
+                });
+            }
+        } catch (const ConfigError& ex) {
+            throw std::runtime_error("Invalid "s + std::string(source) + ": "s + ex.what());
         }
         
-        return map;
+        return game;
     }
 } // namespace
 
@@ -122,23 +251,12 @@ model::Game LoadGame(const std::filesystem::path& json_path) {
     
     std::stringstream buffer;
     buffer << file.rdbuf();
-    std::string json_str = buffer.str();
     
-    // Распарсить строку как JSON
-    auto value = json::parse(json_str);
-    const auto& root = value.as_object();
-    
-    model::Game game;
-    
-    // Обрабатываем массив карт
-    const auto& maps_array = root.at(MAPS_KEY).as_array();
-    for (const auto& map_value : maps_array) {
-        const auto& map_obj = map_value.as_object();
-        model::Map map = ParseMap(map_obj);
-        game.AddMap(std::move(map));
-    }
-    
-    return game;
+    return ParseGameConfig(buffer.str(), "config file " + json_path.string());
+}
+
+model::Game ParseGame(std::string_view json_text) {
+    return ParseGameConfig(json_text, "config"sv);
 }
 
 }  // namespace json_loader
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <string_view>
 
 #include "model.h"
 
@@ -8,4 +9,8 @@ namespace json_loader {
 
 model::Game LoadGame(const std::filesystem::path& json_path);
 
+// Разбирает конфигурацию игры из строки. Выбрасывает std::runtime_error,
+// если строка не является корректной конфигурацией
+model::Game ParseGame(std::string_view json_text);
+
 }  // namespace json_loader
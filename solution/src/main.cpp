@@ -2,11 +2,27 @@
 //
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <thread>
+#include <unordered_map>
 
+#include "application.h"
+#include "cpu_affinity.h"
+#include "journal.h"
 #include "json_loader.h"
 #include "request_handler.h"
+#include "snapshot.h"
+#include "state_broadcaster.h"
+#include "ticker.h"
+#include "tracing.h"
+#include "traffic_capture.h"
 
 using namespace std::literals;
 namespace net = boost::asio;
@@ -14,63 +30,413 @@ namespace sys = boost::system;
 
 namespace {
 
-// Запускает функцию fn на n потоках, включая текущий
+// Запускает функцию fn(index) на n потоках, включая текущий.
+// Текущий поток получает индекс 0, остальные - индексы от 1 до n-1
 template <typename Fn>
 void RunWorkers(unsigned n, const Fn& fn) {
     n = std::max(1u, n);
     std::vector<std::jthread> workers;
     workers.reserve(n - 1);
     // Запускаем n-1 рабочих потоков, выполняющих функцию fn
-    while (--n) {
-        workers.emplace_back(fn);
+    for (unsigned index = 1; index < n; ++index) {
+        workers.emplace_back(fn, index);
     }
-    fn();
+    fn(0u);
+}
+
+using MapResponsesReplicas = std::unordered_map<unsigned, std::unique_ptr<http_handler::MapResponses>>;
+
+// Создаёт по копии подготовленных ответов на каждый процессорный сокет, к которому относятся cpus.
+// Копия строится потоком, привязанным к процессору этого сокета, поэтому её память
+// выделяется на узле этого сокета (политика first-touch)
+MapResponsesReplicas MakeSocketReplicas(const model::Game& game, const std::vector<unsigned>& cpus) {
+    MapResponsesReplicas replicas;
+    for (unsigned cpu : cpus) {
+        const auto socket = util::GetCpuSocket(cpu);
+        if (!socket || replicas.contains(*socket)) {
+            continue;
+        }
+        std::exception_ptr error;
+        std::jthread{[&] {
+            try {
+                util::PinCurrentThread(cpu);
+                replicas.emplace(*socket, std::make_unique<http_handler::MapResponses>(game));
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }}.join();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return replicas;
+}
+
+// Ждёт закрытия всех сессий, но не дольше timeout, затем останавливает ioc.
+// Пока ожидание идёт, раз в секунду сообщает число открытых сессий и обрабатываемых запросов
+void DrainAndStop(net::io_context& ioc, const http_server::ConnectionTracker& tracker,
+                  std::chrono::milliseconds timeout) {
+    static constexpr auto POLL_PERIOD = 100ms;
+    static constexpr auto REPORT_PERIOD = 1s;
+
+    auto ticker = std::make_shared<util::Ticker>(
+        net::make_strand(ioc), POLL_PERIOD,
+        [&ioc, &tracker, remaining = timeout,
+         since_report = std::chrono::milliseconds{}](std::chrono::milliseconds delta) mutable {
+            const size_t sessions = tracker.GetActiveSessions();
+            const size_t requests = tracker.GetInFlightRequests();
+            if (sessions == 0 && requests == 0) {
+                std::cout << "All connections closed, stopping..."sv << std::endl;
+                return ioc.stop();
+            }
+            if (delta >= remaining) {
+                std::cout << "Drain timeout expired: sessions="sv << sessions << " requests="sv << requests
+                          << ", stopping..."sv << std::endl;
+                return ioc.stop();
+            }
+            remaining -= delta;
+            since_report += delta;
+            if (since_report >= REPORT_PERIOD) {
+                since_report = {};
+                std::cout << "Draining: sessions="sv << sessions << " requests="sv << requests << std::endl;
+            }
+        });
+    ticker->Start();
+}
+
+struct Args {
+    std::string config_file;
+    std::string state_file;
+    std::optional<unsigned> save_state_period;
+    std::string journal_file;
+    unsigned journal_commit_interval = 5;
+    unsigned journal_commit_batch = 256;
+    std::string capture_file;
+    unsigned tick_period = 50;
+    std::vector<std::string> listen;
+    std::vector<std::string> tls_listen;
+    std::string tls_cert;
+    std::string tls_key;
+    unsigned drain_timeout = 10000;
+    bool pin_workers = false;
+    std::string cpu_list;
+    bool socket_replicas = false;
+    unsigned trace_sample_every = 0;
+    bool trace_admin_api = false;
+    std::string admin_listen = "127.0.0.1:8081";
+    std::string trace_file = "trace.json";
+};
+
+// Разбирает адрес вида "0.0.0.0:8080" или "[::]:8080"
+net::ip::tcp::endpoint ParseEndpoint(std::string_view str) {
+    const auto colon_pos = str.rfind(':');
+    if (colon_pos == std::string_view::npos || colon_pos + 1 == str.size()) {
+        throw std::runtime_error("Invalid listen address: "s + std::string{str});
+    }
+    std::string_view host = str.substr(0, colon_pos);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    const auto port = std::stoul(std::string{str.substr(colon_pos + 1)});
+    if (port > 65535) {
+        throw std::runtime_error("Invalid listen port: "s + std::string{str});
+    }
+    return {net::ip::make_address(host), static_cast<unsigned short>(port)};
+}
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description desc{"Allowed options"s};
+
+    Args args;
+    unsigned save_state_period = 0;
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("config-file,c", po::value(&args.config_file)->value_name("file"s), "set config file path")
+        ("state-file", po::value(&args.state_file)->value_name("file"s), "set game state file path")
+        ("save-state-period", po::value(&save_state_period)->value_name("milliseconds"s),
+         "set period of automatic game state saving")
+        ("journal-file", po::value(&args.journal_file)->value_name("file"s),
+         "set player actions journal path (requires --state-file)")
+        ("journal-commit-interval", po::value(&args.journal_commit_interval)->value_name("milliseconds"s),
+         "set max delay of journal group commit (5 by default)")
+        ("journal-commit-batch", po::value(&args.journal_commit_batch)->value_name("records"s),
+         "set max number of records in journal group commit (256 by default)")
+        ("capture-file", po::value(&args.capture_file)->value_name("file"s),
+         "record incoming requests and responses to file for traffic_replay")
+        ("tick-period,t", po::value(&args.tick_period)->value_name("milliseconds"s),
+         "set period of game state updates pushed to WebSocket subscribers (50 by default)")
+        ("listen", po::value(&args.listen)->multitoken()->value_name("address:port"s),
+         "listen for plain HTTP on address, e.g. 0.0.0.0:8080 or [::]:8080 (0.0.0.0:8080 by default)")
+        ("tls-listen", po::value(&args.tls_listen)->multitoken()->value_name("address:port"s),
+         "listen for HTTPS on address (requires --tls-cert and --tls-key)")
+        ("tls-cert", po::value(&args.tls_cert)->value_name("file"s), "set TLS certificate chain file (PEM)")
+        ("tls-key", po::value(&args.tls_key)->value_name("file"s), "set TLS private key file (PEM)")
+        ("drain-timeout", po::value(&args.drain_timeout)->value_name("milliseconds"s),
+         "set max time to wait for open connections on SIGINT/SIGTERM (10000 by default)")
+        ("pin-workers", po::bool_switch(&args.pin_workers), "pin each worker thread to its own CPU")
+        ("cpu-list", po::value(&args.cpu_list)->value_name("list"s),
+         "run one worker per CPU from list, e.g. 0-7,16-23 (implies --pin-workers)")
+        ("socket-replicas", po::bool_switch(&args.socket_replicas),
+         "keep a copy of precomputed map responses in the memory of each CPU socket (implies --pin-workers)")
+        ("trace-sample-every", po::value(&args.trace_sample_every)->value_name("requests"s),
+         "trace every N-th request (0 by default, tracing is disabled)")
+        ("trace-admin-api", po::bool_switch(&args.trace_admin_api),
+         "enable /api/v1/admin/trace endpoint to change sampling and export traces (served on --admin-listen)")
+        ("admin-listen", po::value(&args.admin_listen)->value_name("address:port"s),
+         "listen for admin requests on address, never exposed on --listen/--tls-listen (127.0.0.1:8081 by default)")
+        ("trace-file", po::value(&args.trace_file)->value_name("file"s),
+         "set file to dump traces to on SIGUSR1 (trace.json by default)");
+
+    po::positional_options_description positional;
+    positional.add("config-file", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (vm.contains("help"s)) {
+        std::cout << "Usage: game_server [options] <game-config-json>"sv << std::endl << desc;
+        return std::nullopt;
+    }
+    if (!vm.contains("config-file"s)) {
+        throw std::runtime_error("Config file has not been specified");
+    }
+    if (vm.contains("save-state-period"s)) {
+        if (args.state_file.empty()) {
+            throw std::runtime_error("--save-state-period requires --state-file");
+        }
+        args.save_state_period = save_state_period;
+    }
+    if (!args.journal_file.empty() && args.state_file.empty()) {
+        throw std::runtime_error("--journal-file requires --state-file");
+    }
+    if (!args.tls_listen.empty() && (args.tls_cert.empty() || args.tls_key.empty())) {
+        throw std::runtime_error("--tls-listen requires --tls-cert and --tls-key");
+    }
+    if (!args.cpu_list.empty() || args.socket_replicas) {
+        args.pin_workers = true;
+    }
+    if (args.listen.empty() && args.tls_listen.empty()) {
+        args.listen.push_back("0.0.0.0:8080"s);
+    }
+    return args;
 }
 
 }  // namespace
 
 int main(int argc, const char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: game_server <game-config-json>"sv << std::endl;
-        return EXIT_FAILURE;
-    }
     try {
+        auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+
         // 1. Загружаем карту из файла и построить модель игры
-        model::Game game = json_loader::LoadGame(argv[1]);
+        model::Game game = json_loader::LoadGame(args->config_file);
 
-        // 2. Инициализируем io_context
-        const unsigned num_threads = std::thread::hardware_concurrency();
+        // 2. Инициализируем io_context.
+        // Учёт соединений объявлен раньше, так как сессии обращаются к нему при разрушении io_context
+        http_server::ConnectionTracker tracker;
+        // При привязке потоков к процессорам запускаем по рабочему потоку на процессор
+        std::vector<unsigned> worker_cpus;
+        if (args->pin_workers) {
+            const auto available_cpus = util::GetAvailableCpus();
+            worker_cpus = args->cpu_list.empty() ? available_cpus : util::ParseCpuList(args->cpu_list);
+            for (unsigned cpu : worker_cpus) {
+                if (std::find(available_cpus.begin(), available_cpus.end(), cpu) == available_cpus.end()) {
+                    throw std::runtime_error("CPU "s + std::to_string(cpu) + " is not available"s);
+                }
+            }
+        }
+        const unsigned num_threads =
+            worker_cpus.empty() ? std::thread::hardware_concurrency() : static_cast<unsigned>(worker_cpus.size());
         net::io_context ioc(num_threads);
 
-        // 3. Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
+        // 3. SIGINT и SIGTERM запускают плавную остановку: новые соединения не принимаются,
+        // открытые сессии закрываются после отправки текущего ответа.
+        // Повторный сигнал останавливает сервер, не дожидаясь закрытия соединений
         net::signal_set signals(ioc, SIGINT, SIGTERM);
-        signals.async_wait([&ioc](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
-            if (!ec) {
-                std::cout << "Signal received, stopping..."sv << std::endl;
-                ioc.stop();
+        signals.async_wait([&](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+            if (ec) {
+                return;
             }
+            std::cout << "Signal received, draining connections..."sv << std::endl;
+            tracker.StartDrain();
+            DrainAndStop(ioc, tracker, std::chrono::milliseconds{args->drain_timeout});
+            signals.async_wait([&ioc](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+                if (!ec) {
+                    std::cout << "Signal received, stopping..."sv << std::endl;
+                    ioc.stop();
+                }
+            });
         });
 
         // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
-        http_handler::RequestHandler handler{game};
-
-        // 5. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
-        const auto address = net::ip::make_address("0.0.0.0");
-        constexpr unsigned short port = 8080;
-        const net::ip::tcp::endpoint endpoint{address, port};
-        
-        http_server::ServeHttp(ioc, endpoint, [&handler](auto&& req, auto&& send) {
-            handler(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send));
-        });
+        app::Application application{game, ioc};
+        http_handler::StateBroadcaster broadcaster{application};
+        http_handler::RequestHandler handler{game, application, broadcaster};
+
+        // Трассировщик создаётся всегда, чтобы трассировку можно было включить во время работы.
+        // SIGUSR1 записывает накопленные трассы в файл в формате Chrome Trace Event
+        tracing::Tracer tracer{args->trace_sample_every};
+        if (args->trace_admin_api) {
+            handler.SetTracer(&tracer);
+        }
+        net::signal_set trace_signals(ioc, SIGUSR1);
+        std::function<void(const sys::error_code&, int)> on_trace_signal =
+            [&](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+                if (ec) {
+                    return;
+                }
+                try {
+                    tracer.DumpChromeTrace(args->trace_file);
+                    std::cout << "Traces dumped to "sv << args->trace_file << std::endl;
+                } catch (const std::exception& ex) {
+                    std::cerr << "Failed to dump traces: "sv << ex.what() << std::endl;
+                }
+                trace_signals.async_wait(on_trace_signal);
+            };
+        trace_signals.async_wait(on_trace_signal);
+
+        // Рассылаем изменения состояния игровых сеансов подписчикам каждый тик
+        auto broadcast_ticker = std::make_shared<util::Ticker>(
+            net::make_strand(ioc), std::chrono::milliseconds{args->tick_period},
+            [&broadcaster](std::chrono::milliseconds) {
+                broadcaster.Tick();
+            });
+        broadcast_ticker->Start();
+
+        // 5. Восстанавливаем состояние из последнего снимка и журнала действий,
+        // включаем журнал и периодическое сохранение
+        // Журнал объявлен раньше, так как SnapshotWriter обращается к нему после записи снимка
+        std::optional<persistence::Journal> journal;
+        std::optional<persistence::SnapshotWriter> snapshot_writer;
+        if (!args->state_file.empty()) {
+            if (auto state = persistence::ReadSnapshot(args->state_file)) {
+                application.RestoreState(*state);
+                std::cout << "State restored: players="sv << state->players.size() << std::endl;
+            }
+            snapshot_writer.emplace(args->state_file);
+        }
+        if (!args->journal_file.empty()) {
+            journal.emplace(args->journal_file, std::chrono::milliseconds{args->journal_commit_interval},
+                            args->journal_commit_batch);
+            const auto journal_state = journal->Replay();
+            application.RestoreState(journal_state);
+            std::cout << "Journal replayed: records="sv << journal_state.players.size() << std::endl;
+            application.SetActionListener(&*journal);
+        }
+
+        // Сохраняет снимок состояния. Сегменты журнала, предшествующие снимку, удаляются после его записи
+        auto save_state = [&snapshot_writer, &journal](app::GameState state, std::chrono::nanoseconds pause,
+                                                       std::optional<std::uint64_t> journal_segment) {
+            persistence::SnapshotWriter::SavedHandler on_saved;
+            if (journal_segment) {
+                on_saved = [&journal, segment = *journal_segment] {
+                    journal->RemoveSegmentsBefore(segment);
+                };
+            }
+            snapshot_writer->Submit(std::move(state), pause, std::move(on_saved));
+        };
+
+        if (args->save_state_period) {
+            auto ticker = std::make_shared<util::Ticker>(
+                net::make_strand(ioc), std::chrono::milliseconds{*args->save_state_period},
+                [&application, &journal, save_state](std::chrono::milliseconds) {
+                    // Сериализация и запись выполняются в потоке SnapshotWriter
+                    auto collect_state = [&application, save_state](std::optional<std::uint64_t> journal_segment) {
+                        application.AsyncCollectState(
+                            [save_state, journal_segment](app::GameState state, std::chrono::nanoseconds pause) {
+                                save_state(std::move(state), pause, journal_segment);
+                            });
+                    };
+                    if (!journal) {
+                        return collect_state(std::nullopt);
+                    }
+                    // В снимок попадают только подтверждённые входы игроков, поэтому состояние собираем,
+                    // когда все записи, сделанные до переключения сегмента, подтверждены
+                    journal->Rotate(collect_state);
+                });
+            ticker->Start();
+        }
+
+        // 6. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
+        std::optional<traffic::TrafficRecorder> recorder;
+        if (!args->capture_file.empty()) {
+            recorder.emplace(args->capture_file);
+        }
+
+        auto serve = [&](const std::string& address, std::shared_ptr<http_server::ssl::context> ssl_context) {
+            const auto endpoint = ParseEndpoint(address);
+            const bool is_tls = ssl_context != nullptr;
+            http_server::ServeHttp(ioc, endpoint, [&handler](auto&& req, auto&& send, auto&& accept_websocket) {
+                handler(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send),
+                        std::forward<decltype(accept_websocket)>(accept_websocket));
+            }, http_server::SessionServices{recorder ? &*recorder : nullptr, &tracker, &tracer}, std::move(ssl_context));
+            std::cout << "Listening on "sv << (is_tls ? "https://"sv : "http://"sv) << endpoint << std::endl;
+        };
+
+        for (const auto& address : args->listen) {
+            serve(address, nullptr);
+        }
+        // Служебные эндпоинты обслуживаются отдельным листенером, по умолчанию только на loopback.
+        // Его запросы не записываются и не трассируются
+        if (args->trace_admin_api) {
+            const auto endpoint = ParseEndpoint(args->admin_listen);
+            http_server::ServeHttp(ioc, endpoint, [&handler](auto&& req, auto&& send, auto&&) {
+                handler.HandleAdminRequest(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send));
+            }, http_server::SessionServices{nullptr, &tracker, nullptr});
+            std::cout << "Admin API listening on http://"sv << endpoint << std::endl;
+        }
+        if (!args->tls_listen.empty()) {
+            // Один контекст на все TLS-адреса, чтобы сессии возобновлялись на любом из них
+            auto ssl_context = http_server::MakeServerSslContext(args->tls_cert, args->tls_key);
+            for (const auto& address : args->tls_listen) {
+                serve(address, ssl_context);
+            }
+        }
 
         // Эта надпись сообщает тестам о том, что сервер запущен и готов обрабатывать запросы
         std::cout << "Server has started..."sv << std::endl;
-        std::cout << "Listening on " << address << ":" << port << std::endl;
 
-        // 6. Запускаем обработку асинхронных операций
-        RunWorkers(std::max(1u, num_threads), [&ioc] {
+        // 7. Запускаем обработку асинхронных операций
+        MapResponsesReplicas replicas;
+        if (args->socket_replicas) {
+            replicas = MakeSocketReplicas(game, worker_cpus);
+            std::cout << "Map responses replicated to "sv << replicas.size() << " CPU socket(s)"sv << std::endl;
+        }
+        RunWorkers(std::max(1u, num_threads), [&ioc, &worker_cpus, &replicas](unsigned index) {
+            if (!worker_cpus.empty()) {
+                const unsigned cpu = worker_cpus[index % worker_cpus.size()];
+                util::PinCurrentThread(cpu);
+                if (const auto socket = util::GetCpuSocket(cpu)) {
+                    if (auto it = replicas.find(*socket); it != replicas.end()) {
+                        http_handler::RequestHandler::UseLocalMapResponses(it->second.get());
+                    }
+                }
+            }
             ioc.run();
         });
+
+        // 8. Сохраняем итоговое состояние: обработка запросов уже остановлена
+        if (snapshot_writer) {
+            std::optional<std::uint64_t> journal_segment;
+            if (journal) {
+                // Дожидаемся подтверждения записей, сделанных до переключения сегмента
+                std::promise<void> rotated;
+                journal_segment = journal->Rotate([&rotated](std::uint64_t) {
+                    rotated.set_value();
+                });
+                rotated.get_future().wait();
+            }
+            save_state(application.CollectState(), {}, journal_segment);
+            snapshot_writer->Stop();
+        }
+        if (journal) {
+            journal->Stop();
+        }
     } catch (const std::exception& ex) {
         std::cerr << ex.what() << std::endl;
         return EXIT_FAILURE;
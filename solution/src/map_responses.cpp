@@ -0,0 +1,130 @@
+#include "map_responses.h"
+
+#include <boost/json.hpp>
+
+#include "binary_io.h"
+
+namespace http_handler {
+
+namespace json = boost::json;
+using namespace std::literals;
+
+namespace {
+
+constexpr std::string_view MAP_BINARY_MAGIC = "GMAP"sv;
+constexpr std::uint32_t MAP_BINARY_VERSION = 1;
+
+std::string SerializeMapsListJson(const model::Game& game) {
+    json::array maps_array;
+    
+    for (const auto& map : game.GetMaps()) {
+        json::object map_obj;
+        map_obj["id"] = (*map.GetId()).View();
+        map_obj["name"] = map.GetName();
+        maps_array.push_back(std::move(map_obj));
+    }
+    
+    return json::serialize(maps_array);
+}
+
+void WriteInts(binary_io::BinaryWriter& writer, std::initializer_list<std::int32_t> values) {
+    for (std::int32_t value : values) {
+        writer.Write(value);
+    }
+}
+
+}  // namespace
+
+MapResponses::MapResponses(const model::Game& game)
+    : maps_list_json_{std::make_shared<const std::string>(SerializeMapsListJson(game))} {
+    for (const auto& map : game.GetMaps()) {
+        maps_.emplace(map.GetId(), MapData{std::make_shared<const std::string>(SerializeMapJson(map)),
+                                           std::make_shared<const std::string>(SerializeMapBinary(map))});
+    }
+}
+
+std::string SerializeMapJson(const model::Map& map) {
+    json::object map_obj;
+    map_obj["id"] = (*map.GetId()).View();
+    map_obj["name"] = map.GetName();
+    
+    // Добавляем дороги
+    json::array roads_array;
+    for (const auto& road : map.GetRoads()) {
+        json::object road_obj;
+        road_obj["x0"] = road.GetStart().x;
+        road_obj["y0"] = road.GetStart().y;
+        
+        if (road.IsHorizontal()) {
+            road_obj["x1"] = road.GetEnd().x;
+        } else {
+            road_obj["y1"] = road.GetEnd().y;
+        }
+        
+        roads_array.push_back(std::move(road_obj));
+    }
+    map_obj["roads"] = std::move(roads_array);
+    
+    // Добавляем здания
+    json::array buildings_array;
+    for (const auto& building : map.GetBuildings()) {
+        const auto& bounds = building.GetBounds();
+        json::object building_obj;
+        building_obj["x"] = bounds.position.x;
+        building_obj["y"] = bounds.position.y;
+        building_obj["w"] = bounds.size.width;
+        building_obj["h"] = bounds.size.height;
+        buildings_array.push_back(std::move(building_obj));
+    }
+    map_obj["buildings"] = std::move(buildings_array);
+    
+    // Добавляем офисы
+    json::array offices_array;
+    for (const auto& office : map.GetOffices()) {
+        json::object office_obj;
+        office_obj["id"] = (*office.GetId()).View();
+        office_obj["x"] = office.GetPosition().x;
+        office_obj["y"] = office.GetPosition().y;
+        office_obj["offsetX"] = office.GetOffset().dx;
+        office_obj["offsetY"] = office.GetOffset().dy;
+        offices_array.push_back(std::move(office_obj));
+    }
+    map_obj["offices"] = std::move(offices_array);
+    
+    return json::serialize(map_obj);
+}
+
+std::string SerializeMapBinary(const model::Map& map) {
+    binary_io::BinaryWriter writer;
+    writer.WriteBytes(MAP_BINARY_MAGIC);
+    writer.Write(MAP_BINARY_VERSION);
+    writer.WriteString(*map.GetId());
+    writer.WriteString(map.GetName());
+    
+    const auto& roads = map.GetRoads();
+    writer.Write(static_cast<std::uint32_t>(roads.size()));
+    for (const auto& road : roads) {
+        WriteInts(writer, {road.GetStart().x, road.GetStart().y, road.GetEnd().x, road.GetEnd().y});
+    }
+    
+    const auto& buildings = map.GetBuildings();
+    writer.Write(static_cast<std::uint32_t>(buildings.size()));
+    for (const auto& building : buildings) {
+        const auto& bounds = building.GetBounds();
+        WriteInts(writer, {bounds.position.x, bounds.position.y, bounds.size.width, bounds.size.height});
+    }
+    
+    const auto& offices = map.GetOffices();
+    writer.Write(static_cast<std::uint32_t>(offices.size()));
+    for (const auto& office : offices) {
+        WriteInts(writer, {office.GetPosition().x, office.GetPosition().y, office.GetOffset().dx,
+                           office.GetOffset().dy});
+    }
+    for (const auto& office : offices) {
+        writer.WriteString(*office.GetId());
+    }
+    
+    return std::move(writer.GetBuffer());
+}
+
+}  // namespace http_handler
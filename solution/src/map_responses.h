@@ -0,0 +1,68 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "model.h"
+
+namespace http_handler {
+
+// Тип содержимого компактного двоичного представления карты
+constexpr std::string_view MAP_BINARY_CONTENT_TYPE = "application/x-game-map";
+
+/*
+ * Двоичное представление карты (все числа little-endian, строки - uint32 длина + байты UTF-8):
+ *
+ *  char[4]  magic = "GMAP"
+ *  uint32   version = 1
+ *  string   id
+ *  string   name
+ *  uint32   roads_count
+ *  int32    roads[roads_count][4]          x0, y0, x1, y1
+ *  uint32   buildings_count
+ *  int32    buildings[buildings_count][4]  x, y, w, h
+ *  uint32   offices_count
+ *  int32    offices[offices_count][4]      x, y, offsetX, offsetY
+ *  string   office_ids[offices_count]
+ *
+ * Координаты хранятся упакованными массивами, поэтому клиент может читать их без разбора.
+ */
+
+// Ответы на запросы карт, подготовленные при загрузке игры:
+// список карт в JSON и каждая карта в JSON и в двоичном виде.
+// Строки разделяются с отправляемыми ответами, а не копируются в них
+class MapResponses {
+public:
+    using Body = std::shared_ptr<const std::string>;
+
+    struct MapData {
+        Body json;
+        Body binary;
+    };
+
+    explicit MapResponses(const model::Game& game);
+
+    const Body& GetMapsListJson() const noexcept {
+        return maps_list_json_;
+    }
+
+    // Возвращает nullptr, если карта не найдена
+    const MapData* FindMap(const model::Map::Id& id) const noexcept {
+        if (auto it = maps_.find(id); it != maps_.end()) {
+            return &it->second;
+        }
+        return nullptr;
+    }
+
+private:
+    using MapIdHasher = util::TaggedHasher<model::Map::Id>;
+
+    Body maps_list_json_;
+    std::unordered_map<model::Map::Id, MapData, MapIdHasher> maps_;
+};
+
+std::string SerializeMapJson(const model::Map& map);
+std::string SerializeMapBinary(const model::Map& map);
+
+}  // namespace http_handler
@@ -24,7 +24,7 @@ void Map::AddOffice(Office office) {
 void Game::AddMap(Map map) {
     const size_t index = maps_.size();
     if (auto [it, inserted] = map_id_to_index_.emplace(map.GetId(), index); !inserted) {
-        throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
+        throw std::invalid_argument("Map with id "s + std::string{*map.GetId()} + " already exists"s);
     } else {
         try {
             maps_.emplace_back(std::move(map));
@@ -35,4 +35,15 @@ void Game::AddMap(Map map) {
     }
 }
 
+Dog& GameSession::AddDog(Dog::Id id, std::string name) {
+    // Собака появляется в начале первой дороги карты
+    const auto& roads = map_->GetRoads();
+    const Point position = roads.empty() ? Point{0, 0} : roads.front().GetStart();
+    return AddDog(id, std::move(name), position);
+}
+
+Dog& GameSession::AddDog(Dog::Id id, std::string name, Point position) {
+    return dogs_.emplace_back(id, std::move(name), position);
+}
+
 }  // namespace model
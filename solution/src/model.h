@@ -1,12 +1,19 @@
 #pragma once
+#include <cstdint>
+#include <deque>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "fixed_string.h"
 #include "tagged.h"
 
 namespace model {
 
+// Строка для идентификаторов карт и офисов. Идентификаторы короткие ("map1", "o0"),
+// поэтому хранятся внутри объекта вместе с заранее вычисленным хешем
+using IdString = util::FixedString<31>;
+
 using Dimension = int;
 using Coord = Dimension;
 
@@ -87,7 +94,7 @@ private:
 
 class Office {
 public:
-    using Id = util::Tagged<std::string, Office>;
+    using Id = util::Tagged<IdString, Office>;
 
     Office(Id id, Point position, Offset offset) noexcept
         : id_{std::move(id)}
@@ -115,7 +122,7 @@ private:
 
 class Map {
 public:
-    using Id = util::Tagged<std::string, Map>;
+    using Id = util::Tagged<IdString, Map>;
     using Roads = std::vector<Road>;
     using Buildings = std::vector<Building>;
     using Offices = std::vector<Office>;
@@ -192,4 +199,61 @@ private:
     MapIdToIndex map_id_to_index_;
 };
 
+class Dog {
+public:
+    using Id = util::Tagged<std::uint64_t, Dog>;
+
+    Dog(Id id, std::string name, Point position) noexcept
+        : id_{id}
+        , name_{std::move(name)}
+        , position_{position} {
+    }
+
+    const Id& GetId() const noexcept {
+        return id_;
+    }
+
+    const std::string& GetName() const noexcept {
+        return name_;
+    }
+
+    Point GetPosition() const noexcept {
+        return position_;
+    }
+
+private:
+    Id id_;
+    std::string name_;
+    Point position_;
+};
+
+// Игровой сеанс на конкретной карте. Собаки хранятся в deque,
+// поэтому указатели на них остаются валидными при добавлении новых
+class GameSession {
+public:
+    using Dogs = std::deque<Dog>;
+
+    explicit GameSession(const Map& map) noexcept
+        : map_{&map} {
+    }
+
+    const Map& GetMap() const noexcept {
+        return *map_;
+    }
+
+    const Dogs& GetDogs() const noexcept {
+        return dogs_;
+    }
+
+    // Добавляет собаку в начало первой дороги карты
+    Dog& AddDog(Dog::Id id, std::string name);
+
+    // Добавляет собаку в заданную позицию (например, при восстановлении состояния)
+    Dog& AddDog(Dog::Id id, std::string name, Point position);
+
+private:
+    const Map* map_;
+    Dogs dogs_;
+};
+
 }  // namespace model
@@ -0,0 +1,86 @@
+#include "players.h"
+
+#include <openssl/rand.h>
+
+#include <array>
+#include <stdexcept>
+
+namespace app {
+
+namespace {
+
+bool IsHexDigit(char c) noexcept {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+}  // namespace
+
+// Генерирует 128-битный случайный токен в виде 32 шестнадцатеричных цифр.
+// Токен - это учётные данные игрока, поэтому случайные байты берутся из криптографически
+// стойкого генератора OpenSSL: по выданным токенам нельзя предсказать следующие
+Token GenerateToken() {
+    std::array<unsigned char, TOKEN_LENGTH / 2> bytes;
+    if (RAND_bytes(bytes.data(), static_cast<int>(bytes.size())) != 1) {
+        throw std::runtime_error("Failed to generate player token");
+    }
+
+    constexpr char HEX_DIGITS[] = "0123456789abcdef";
+    std::string token(TOKEN_LENGTH, '0');
+    size_t pos = 0;
+    for (unsigned char byte : bytes) {
+        token[pos++] = HEX_DIGITS[byte >> 4];
+        token[pos++] = HEX_DIGITS[byte & 0xF];
+    }
+    return Token{std::move(token)};
+}
+
+bool IsValidToken(std::string_view token) noexcept {
+    if (token.size() != TOKEN_LENGTH) {
+        return false;
+    }
+    for (char c : token) {
+        if (!IsHexDigit(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PlayerTokens::ReserveToken(const Token& token) {
+    const size_t hash = TokenHasher{}(*token);
+    Shard& shard = shards_[GetShardIndex(hash)];
+    std::unique_lock lock{shard.mutex};
+    return shard.token_to_player.emplace(*token, nullptr).second;
+}
+
+void PlayerTokens::AddPlayer(Player& player) {
+    const Token& token = player.GetToken();
+    const size_t hash = TokenHasher{}(*token);
+    Shard& shard = shards_[GetShardIndex(hash)];
+    std::unique_lock lock{shard.mutex};
+    // Занятый через ReserveToken токен ещё не связан ни с одним игроком
+    auto [it, inserted] = shard.token_to_player.emplace(*token, &player);
+    if (!inserted) {
+        if (it->second) {
+            throw std::invalid_argument("Duplicate player token");
+        }
+        it->second = &player;
+    }
+}
+
+Player* PlayerTokens::FindPlayerByToken(std::string_view token) const noexcept {
+    const size_t hash = TokenHasher{}(token);
+    const Shard& shard = shards_[GetShardIndex(hash)];
+    std::shared_lock lock{shard.mutex};
+    if (auto it = shard.token_to_player.find(token); it != shard.token_to_player.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
+Player& Players::Add(Player::Id id, Token token, model::GameSession& session, model::Dog& dog) {
+    std::lock_guard lock{mutex_};
+    return players_.emplace_back(id, std::move(token), session, dog);
+}
+
+}  // namespace app
@@ -0,0 +1,124 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "model.h"
+#include "tagged.h"
+
+namespace app {
+
+namespace detail {
+struct TokenTag {};
+}  // namespace detail
+
+using Token = util::Tagged<std::string, detail::TokenTag>;
+
+// Длина токена: 128 бит в виде 32 шестнадцатеричных цифр
+constexpr size_t TOKEN_LENGTH = 32;
+
+// Генерирует новый случайный токен
+Token GenerateToken();
+
+// Проверяет, что строка похожа на токен (32 шестнадцатеричные цифры).
+// Не выделяет память, поэтому годится для проверки каждого запроса
+bool IsValidToken(std::string_view token) noexcept;
+
+class Player {
+public:
+    using Id = util::Tagged<std::uint64_t, Player>;
+
+    Player(Id id, Token token, model::GameSession& session, model::Dog& dog) noexcept
+        : id_{id}
+        , token_{std::move(token)}
+        , session_{&session}
+        , dog_{&dog} {
+    }
+
+    const Id& GetId() const noexcept {
+        return id_;
+    }
+
+    const Token& GetToken() const noexcept {
+        return token_;
+    }
+
+    const std::string& GetName() const noexcept {
+        return dog_->GetName();
+    }
+
+    model::GameSession& GetSession() const noexcept {
+        return *session_;
+    }
+
+    model::Dog& GetDog() const noexcept {
+        return *dog_;
+    }
+
+private:
+    Id id_;
+    Token token_;
+    model::GameSession* session_;
+    model::Dog* dog_;
+};
+
+// Потокобезопасная таблица "токен -> игрок".
+// Таблица разбита на шарды, у каждого шарда своя блокировка чтения-записи,
+// поэтому поиск игрока по токену не упирается в общий мьютекс
+class PlayerTokens {
+public:
+    // Занимает токен для игрока, который ещё не создан. Возвращает false, если токен уже занят.
+    // Пока игрок не добавлен, FindPlayerByToken не находит его по этому токену
+    bool ReserveToken(const Token& token);
+
+    // Связывает токен игрока с игроком. Токен может быть заранее занят ReserveToken.
+    // Выбрасывает std::invalid_argument, если токен уже связан с другим игроком
+    void AddPlayer(Player& player);
+
+    // Ищет игрока по токену. Не выделяет память
+    Player* FindPlayerByToken(std::string_view token) const noexcept;
+
+private:
+    static constexpr size_t SHARD_COUNT = 64;
+
+    struct TokenHasher {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view token) const noexcept {
+            return std::hash<std::string_view>{}(token);
+        }
+    };
+
+    using TokenToPlayer = std::unordered_map<std::string, Player*, TokenHasher, std::equal_to<>>;
+
+    // Шарды выровнены по кэш-линии, чтобы блокировки соседних шардов не мешали друг другу
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        TokenToPlayer token_to_player;
+    };
+
+    static size_t GetShardIndex(size_t hash) noexcept {
+        // Младшие биты хеша использует сама unordered_map, поэтому шард выбираем по старшим
+        return (hash >> 32) % SHARD_COUNT;
+    }
+
+    std::array<Shard, SHARD_COUNT> shards_;
+};
+
+// Хранилище игроков. Игроки хранятся в deque, поэтому указатели на них стабильны
+class Players {
+public:
+    Player& Add(Player::Id id, Token token, model::GameSession& session, model::Dog& dog);
+
+private:
+    std::mutex mutex_;
+    std::deque<Player> players_;
+};
+
+}  // namespace app
@@ -1,34 +1,65 @@
 #include "request_handler.h"
 #include <boost/json.hpp>
+#include <iostream>
 
 namespace http_handler {
 
 namespace json = boost::json;
 using namespace std::literals;
 
-void RequestHandler::operator()(http_server::StringRequest&& req, std::function<void(http_server::StringResponse&&)> send) {
+namespace {
+constexpr std::string_view API_PREFIX = "/api/"sv;
+constexpr std::string_view MAPS_PATH = "/api/v1/maps"sv;
+constexpr std::string_view MAP_PATH_PREFIX = "/api/v1/maps/"sv;
+constexpr std::string_view ADMIN_TRACE_PATH = "/api/v1/admin/trace"sv;
+}  // namespace
+
+thread_local const MapResponses* RequestHandler::local_map_responses_ = nullptr;
+
+void RequestHandler::operator()(http_server::StringRequest&& req, Sender send,
+                                http_server::WebSocketAccept accept_websocket) {
+    // Маршрутизация выполняется по пути, строка запроса не учитывается
+    const std::string_view target = GetTargetPath(req.target());
+    
+    // Эндпоинты, работающие с состоянием игровых сеансов, выполняются на strand сеанса,
+    // ответ отправляется асинхронно
+    if (target == "/api/v1/game/join"sv) {
+        if (!IsValidMethod(req.method(), {http::verb::post})) {
+            return send(MakeMethodNotAllowedResponse("Only POST method is expected"));
+        }
+        return HandleJoinGame(req, std::move(send));
+    }
+    if (target == "/api/v1/game/players"sv) {
+        if (!IsValidMethod(req.method(), {http::verb::get, http::verb::head})) {
+            return send(MakeMethodNotAllowedResponse("Invalid method"));
+        }
+        return HandleGetPlayers(req, std::move(send));
+    }
+    if (target == "/api/v1/game/state"sv) {
+        return HandleStateSubscription(std::move(req), std::move(send), std::move(accept_websocket));
+    }
+    
+    // Остальные эндпоинты только читают неизменяемые данные и выполняются на strand HTTP-сессии.
+    // Карты отдаются из ответов, подготовленных при загрузке игры, без копирования
+    if (target == MAPS_PATH) {
+        if (!IsValidMethod(req.method(), {http::verb::get})) {
+            return send(MakeMethodNotAllowedResponse("Only GET method is allowed"));
+        }
+        return send(HandleApiMaps(req));
+    }
+    if (target.starts_with(MAP_PATH_PREFIX)) {
+        if (!IsValidMethod(req.method(), {http::verb::get})) {
+            return send(MakeMethodNotAllowedResponse("Only GET method is allowed"));
+        }
+        return HandleApiMap(req, target.substr(MAP_PATH_PREFIX.size()), send);
+    }
+
     auto response = [&]() -> http_server::StringResponse {
-        const auto& target = req.target();
-        
         // Проверяем, что запрос начинается с /api/
-        if (target.starts_with("/api/"sv)) {
-            // Обрабатываем API endpoints
-            if (target == "/api/v1/maps"sv) {
-                if (!IsValidMethod(req.method(), {http::verb::get})) {
-                    return MakeMethodNotAllowedResponse("Only GET method is allowed");
-                }
-                return HandleApiMaps(req);
-            } 
-            else if (target.starts_with("/api/v1/maps/"sv)) {
-                if (!IsValidMethod(req.method(), {http::verb::get})) {
-                    return MakeMethodNotAllowedResponse("Only GET method is allowed");
-                }
-                return HandleApiMap(req);
-            }
-            else {
-                // Неизвестный API endpoint
-                return MakeBadRequestResponse("Invalid API endpoint");
-            }
+        if (target.starts_with(API_PREFIX)) {
+            // Неизвестный API endpoint. Служебные эндпоинты здесь не обслуживаются,
+            // они доступны только через HandleAdminRequest
+            return MakeBadRequestResponse("Invalid API endpoint");
         }
         
         // Для не-API запросов возвращаем 404
@@ -37,29 +68,23 @@ void RequestHandler::operator()(http_server::StringRequest&& req, std::function<
 
     return send(std::move(response));
 }
-http_server::StringResponse RequestHandler::HandleApiMaps(const http_server::StringRequest& req) {
-    json::array maps_array;
-    
-    for (const auto& map : game_.GetMaps()) {
-        json::object map_obj;
-        map_obj["id"] = *map.GetId();
-        map_obj["name"] = map.GetName();
-        maps_array.push_back(std::move(map_obj));
+
+void RequestHandler::HandleAdminRequest(http_server::StringRequest&& req, Sender send) {
+    const std::string_view target = GetTargetPath(req.target());
+    if (tracer_ && target == ADMIN_TRACE_PATH) {
+        if (!IsValidMethod(req.method(), {http::verb::get, http::verb::head, http::verb::post})) {
+            return send(MakeMethodNotAllowedResponse("Invalid method"));
+        }
+        return send(HandleAdminTrace(req));
     }
-    
-    // ВМЕСТО этого (возвращает объект с полем maps):
-    // json::object response_obj;
-    // response_obj["maps"] = std::move(maps_array);
-    
-    // ДОЛЖНО БЫТЬ так (возвращает массив напрямую):
-    // response_obj = std::move(maps_array);
-    
-    http_server::StringResponse response;
+    send(MakeJsonResponse(http::status::not_found, "pageNotFound", "Page not found"));
+}
+http_server::SharedStringResponse RequestHandler::HandleApiMaps(const http_server::StringRequest& req) {
+    // Список карт сериализуется один раз при загрузке игры
+    http_server::SharedStringResponse response;
     response.result(http::status::ok);
     response.set(http::field::content_type, "application/json");
-    
-    // Сериализуем массив напрямую, а не объект
-    response.body() = json::serialize(maps_array);  // ← ИЗМЕНЕНИЕ ЗДЕСЬ
+    response.body() = GetMapResponses().GetMapsListJson();
     response.prepare_payload();
     
     return response;
@@ -86,80 +111,261 @@ http_server::StringResponse RequestHandler::HandleApiMaps(const http_server::Str
     return response;
 }*/
 
-http_server::StringResponse RequestHandler::HandleApiMap(const http_server::StringRequest& req) {
-    const auto& target = req.target();
+void RequestHandler::HandleApiMap(const http_server::StringRequest& req, std::string_view map_id_str,
+                                  const Sender& send) {
+    // map_id_str - часть пути после /api/v1/maps/
+    if (map_id_str.empty()) {
+        return send(MakeBadRequestResponse("Map ID is required"));
+    }
+    // Идентификатор карты - один сегмент пути
+    if (map_id_str.find('/') != std::string_view::npos) {
+        return send(MakeMapNotFoundResponse());
+    }
     
-    // Извлекаем ID карты из URL (формат: /api/v1/maps/{id})
-    std::string map_id_str = std::string(target.substr(std::string("/api/v1/maps/"sv).size()));
+    // Идентификатор, не помещающийся в model::IdString, не может принадлежать ни одной карте
+    if (!model::IdString::Fits(map_id_str)) {
+        return send(MakeMapNotFoundResponse());
+    }
     
-    if (map_id_str.empty()) {
-        return MakeBadRequestResponse("Map ID is required");
+    model::Map::Id map_id{model::IdString{map_id_str}};
+    const auto* map_data = GetMapResponses().FindMap(map_id);
+    
+    if (!map_data) {
+        return send(MakeMapNotFoundResponse());
     }
     
-    model::Map::Id map_id{std::move(map_id_str)};
-    const auto* map = game_.FindMap(map_id);
+    // Карта сериализуется в JSON и в двоичный вид один раз при загрузке игры,
+    // здесь только выбираем представление по заголовку Accept
+    tracing::ScopedSpan span{"select_body"};
+    http_server::SharedStringResponse response;
+    response.result(http::status::ok);
+    response.set(http::field::vary, "Accept");
+    if (AcceptsBinaryMap(req)) {
+        response.set(http::field::content_type, MAP_BINARY_CONTENT_TYPE);
+        response.body() = map_data->binary;
+    } else {
+        response.set(http::field::content_type, "application/json");
+        response.body() = map_data->json;
+    }
+    response.prepare_payload();
     
-    if (!map) {
-        return MakeMapNotFoundResponse();
+    send(std::move(response));
+}
+
+void RequestHandler::HandleJoinGame(const http_server::StringRequest& req, Sender send) {
+    // Разбираем тело запроса: {"userName": "...", "mapId": "..."}
+    std::string user_name;
+    std::string map_id_str;
+    try {
+        const auto value = json::parse(req.body());
+        const auto& obj = value.as_object();
+        user_name = json::value_to<std::string>(obj.at("userName"));
+        map_id_str = json::value_to<std::string>(obj.at("mapId"));
+    } catch (const std::exception&) {
+        return send(MakeJsonResponse(http::status::bad_request, "invalidArgument", "Join game request parse error"));
     }
     
-    // Формируем JSON с детальной информацией о карте
-    json::object map_obj;
-    map_obj["id"] = *map->GetId();
-    map_obj["name"] = map->GetName();
+    if (user_name.empty()) {
+        return send(MakeJsonResponse(http::status::bad_request, "invalidArgument", "Invalid name"));
+    }
     
-    // Добавляем дороги
-    json::array roads_array;
-    for (const auto& road : map->GetRoads()) {
-        json::object road_obj;
-        road_obj["x0"] = road.GetStart().x;
-        road_obj["y0"] = road.GetStart().y;
-        
-        if (road.IsHorizontal()) {
-            road_obj["x1"] = road.GetEnd().x;
-        } else {
-            road_obj["y1"] = road.GetEnd().y;
+    if (!model::IdString::Fits(map_id_str)) {
+        return send(MakeMapNotFoundResponse());
+    }
+    model::Map::Id map_id{model::IdString{map_id_str}};
+    if (!game_.FindMap(map_id)) {
+        return send(MakeMapNotFoundResponse());
+    }
+    
+    // Добавление игрока изменяет состояние сеанса, поэтому выполняется на его strand.
+    // Трасса запроса передаётся в обработчики, выполняемые на других strand
+    auto& strand = app_.GetSessionStrand(map_id);
+    net::dispatch(strand, [this, map_id = std::move(map_id), user_name = std::move(user_name),
+                           send = std::move(send), trace = tracing::GetCurrentTrace()]() mutable {
+        tracing::TraceScope trace_scope{trace};
+        tracing::ScopedSpan span{"session"};
+        // Исключение, покинувшее обработчик на strand, завершило бы рабочий поток io_context,
+        // поэтому отвечаем ошибкой сервера. send копируется в JoinGame, чтобы остаться для ответа об ошибке
+        try {
+            // Ответ отправляется, когда вход игрока сохранён в журнале
+            app_.JoinGame(map_id, std::move(user_name), [this, send, trace](std::optional<app::JoinGameResult> result) {
+                tracing::TraceScope trace_scope{trace};
+                if (!result) {
+                    return send(MakeJsonResponse(http::status::service_unavailable, "internalError",
+                                                 "Failed to save player join"));
+                }
+                tracing::ScopedSpan span{"serialize"};
+                json::object result_obj;
+                result_obj["authToken"] = *result->token;
+                result_obj["playerId"] = *result->player_id;
+                
+                send(MakeNoCacheJsonResponse(json::serialize(result_obj)));
+            });
+        } catch (const std::exception& ex) {
+            std::cerr << "join game: "sv << ex.what() << std::endl;
+            send(MakeInternalErrorResponse());
         }
-        
-        roads_array.push_back(std::move(road_obj));
-    }
-    map_obj["roads"] = std::move(roads_array);
-    
-    // Добавляем здания
-    json::array buildings_array;
-    for (const auto& building : map->GetBuildings()) {
-        const auto& bounds = building.GetBounds();
-        json::object building_obj;
-        building_obj["x"] = bounds.position.x;
-        building_obj["y"] = bounds.position.y;
-        building_obj["w"] = bounds.size.width;
-        building_obj["h"] = bounds.size.height;
-        buildings_array.push_back(std::move(building_obj));
-    }
-    map_obj["buildings"] = std::move(buildings_array);
-    
-    // Добавляем офисы
-    json::array offices_array;
-    for (const auto& office : map->GetOffices()) {
-        json::object office_obj;
-        office_obj["id"] = *office.GetId();
-        office_obj["x"] = office.GetPosition().x;
-        office_obj["y"] = office.GetPosition().y;
-        office_obj["offsetX"] = office.GetOffset().dx;
-        office_obj["offsetY"] = office.GetOffset().dy;
-        offices_array.push_back(std::move(office_obj));
-    }
-    map_obj["offices"] = std::move(offices_array);
+    });
+}
+
+void RequestHandler::HandleGetPlayers(const http_server::StringRequest& req, Sender send) {
+    const auto token = TryExtractToken(req);
+    if (!token) {
+        return send(MakeUnauthorizedResponse("invalidToken", "Authorization header is missing"));
+    }
+    
+    // Поиск по токену потокобезопасен и выполняется на strand HTTP-сессии
+    const auto* player = app_.FindPlayerByToken(*token);
+    if (!player) {
+        return send(MakeUnauthorizedResponse("unknownToken", "Player token has not been found"));
+    }
+    
+    // Список собак читаем на strand игрового сеанса
+    auto& strand = app_.GetSessionStrand(player->GetSession().GetMap().GetId());
+    net::dispatch(strand, [this, player, send = std::move(send), trace = tracing::GetCurrentTrace()] {
+        tracing::TraceScope trace_scope{trace};
+        tracing::ScopedSpan span{"session"};
+        try {
+            // Формируем объект вида {"<id>": {"name": "<name>"}, ...}
+            json::object players_obj;
+            for (const auto& info : app_.GetSessionPlayers(*player)) {
+                json::object player_obj;
+                player_obj["name"] = info.name;
+                players_obj[std::to_string(*info.id)] = std::move(player_obj);
+            }
+            
+            send(MakeNoCacheJsonResponse(json::serialize(players_obj)));
+        } catch (const std::exception& ex) {
+            std::cerr << "get players: "sv << ex.what() << std::endl;
+            send(MakeInternalErrorResponse());
+        }
+    });
+}
+
+void RequestHandler::HandleStateSubscription(http_server::StringRequest&& req, Sender send,
+                                             http_server::WebSocketAccept accept_websocket) {
+    if (!accept_websocket) {
+        return send(MakeBadRequestResponse("WebSocket upgrade is expected"));
+    }
+    
+    const auto token = TryExtractToken(req);
+    if (!token) {
+        return send(MakeUnauthorizedResponse("invalidToken", "Authorization header is missing"));
+    }
     
+    const auto* player = app_.FindPlayerByToken(*token);
+    if (!player) {
+        return send(MakeUnauthorizedResponse("unknownToken", "Player token has not been found"));
+    }
+    
+    // Забираем соединение у HTTP-сессии и подписываем его на изменения сеанса на strand сеанса
+    auto websocket_session = accept_websocket();
+    websocket_session->Run(std::move(req));
+    
+    auto& strand = app_.GetSessionStrand(player->GetSession().GetMap().GetId());
+    net::dispatch(strand, [this, player, websocket_session = std::move(websocket_session)]() mutable {
+        // Ответить по HTTP уже нельзя: соединение передано WebSocket-сессии
+        try {
+            broadcaster_.Subscribe(*player, std::move(websocket_session));
+        } catch (const std::exception& ex) {
+            std::cerr << "state subscription: "sv << ex.what() << std::endl;
+        }
+    });
+}
+
+http_server::StringResponse RequestHandler::HandleAdminTrace(const http_server::StringRequest& req) {
+    // GET возвращает записанные интервалы в формате Chrome Trace Event
+    if (req.method() != http::verb::post) {
+        return MakeNoCacheJsonResponse(tracer_->ExportChromeTrace());
+    }
+    
+    // POST {"sampleEvery": N} задаёт частоту трассировки: каждый N-й запрос, 0 - выключить
+    unsigned sample_every = 0;
+    try {
+        const auto value = json::parse(req.body());
+        sample_every = json::value_to<unsigned>(value.as_object().at("sampleEvery"));
+    } catch (const std::exception&) {
+        return MakeJsonResponse(http::status::bad_request, "invalidArgument", "Trace settings parse error");
+    }
+    tracer_->SetSampleEvery(sample_every);
+    
+    json::object result_obj;
+    result_obj["sampleEvery"] = sample_every;
+    return MakeNoCacheJsonResponse(json::serialize(result_obj));
+}
+
+http_server::StringResponse RequestHandler::MakeNoCacheJsonResponse(std::string body) {
     http_server::StringResponse response;
     response.result(http::status::ok);
     response.set(http::field::content_type, "application/json");
-    response.body() = json::serialize(map_obj);
+    response.set(http::field::cache_control, "no-cache");
+    response.body() = std::move(body);
     response.prepare_payload();
     
     return response;
 }
 
+bool RequestHandler::AcceptsBinaryMap(const http_server::StringRequest& req) {
+    auto it = req.find(http::field::accept);
+    if (it == req.end()) {
+        return false;
+    }
+    
+    // Перебираем элементы вида "type/subtype;q=0.5" через запятую
+    std::string_view accept = it->value();
+    while (!accept.empty()) {
+        const auto comma_pos = accept.find(',');
+        std::string_view item = accept.substr(0, comma_pos);
+        accept.remove_prefix(comma_pos == std::string_view::npos ? accept.size() : comma_pos + 1);
+        
+        const auto params_pos = item.find(';');
+        std::string_view media_type = item.substr(0, params_pos);
+        std::string_view params = params_pos == std::string_view::npos ? ""sv : item.substr(params_pos);
+        
+        while (!media_type.empty() && media_type.front() == ' ') {
+            media_type.remove_prefix(1);
+        }
+        while (!media_type.empty() && media_type.back() == ' ') {
+            media_type.remove_suffix(1);
+        }
+        
+        if (beast::iequals(media_type, MAP_BINARY_CONTENT_TYPE)) {
+            // q=0 (q=0.0, q=0.00 ...) означает явный отказ от представления
+            const auto q_pos = params.find("q="sv);
+            if (q_pos == std::string_view::npos) {
+                return true;
+            }
+            const auto q_value = params.substr(q_pos + 2, params.find(';', q_pos) - q_pos - 2);
+            return q_value.find_first_of("123456789"sv) != std::string_view::npos;
+        }
+    }
+    return false;
+}
+
+std::string_view RequestHandler::GetTargetPath(std::string_view target) noexcept {
+    return target.substr(0, target.find_first_of("?#"sv));
+}
+
+std::optional<std::string_view> RequestHandler::TryExtractToken(const http_server::StringRequest& req) {
+    constexpr std::string_view BEARER_PREFIX = "Bearer "sv;
+    
+    auto it = req.find(http::field::authorization);
+    if (it == req.end()) {
+        return std::nullopt;
+    }
+    
+    std::string_view value = it->value();
+    if (!value.starts_with(BEARER_PREFIX)) {
+        return std::nullopt;
+    }
+    value.remove_prefix(BEARER_PREFIX.size());
+    
+    if (!app::IsValidToken(value)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
 http_server::StringResponse RequestHandler::MakeJsonResponse(
     http::status status, std::string_view code, std::string_view message) {
     
@@ -186,10 +392,18 @@ http_server::StringResponse RequestHandler::MakeMapNotFoundResponse(std::string_
     return MakeJsonResponse(http::status::not_found, "mapNotFound", message);
 }
 
+http_server::StringResponse RequestHandler::MakeInternalErrorResponse(std::string_view message) {
+    return MakeJsonResponse(http::status::internal_server_error, "internalError", message);
+}
+
 http_server::StringResponse RequestHandler::MakeMethodNotAllowedResponse(std::string_view message) {
     return MakeJsonResponse(http::status::method_not_allowed, "methodNotAllowed", message);
 }
 
+http_server::StringResponse RequestHandler::MakeUnauthorizedResponse(std::string_view code, std::string_view message) {
+    return MakeJsonResponse(http::status::unauthorized, code, message);
+}
+
 bool RequestHandler::IsValidMethod(http::verb method, const std::vector<http::verb>& allowed_methods) {
     return std::find(allowed_methods.begin(), allowed_methods.end(), method) != allowed_methods.end();
 }
@@ -1,37 +1,97 @@
 #pragma once
 
+#include "application.h"
 #include "model.h"
 #include "http_server.h"
+#include "map_responses.h"
+#include "state_broadcaster.h"
+#include "tracing.h"
 #include <boost/json.hpp>
 #include <boost/beast.hpp>
+#include <optional>
 
 namespace http_handler {
 
+namespace net = boost::asio;
 namespace beast = boost::beast;
 namespace http = beast::http;
 
 class RequestHandler {
 public:
-    explicit RequestHandler(model::Game& game) 
-        : game_(game) {
+    RequestHandler(model::Game& game, app::Application& app, StateBroadcaster& broadcaster)
+        : game_(game)
+        , app_(app)
+        , broadcaster_(broadcaster)
+        , map_responses_(game) {
     }
 
 
-    // Обработчик HTTP-запросов
-    void operator()(http_server::StringRequest&& req, std::function<void(http_server::StringResponse&&)> send);
+    using Sender = http_server::ResponseSender;
+
+    // Обработчик HTTP-запросов. Запросы к неизменяемым данным обрабатываются сразу,
+    // запросы к состоянию игровых сеансов передаются на strand сеанса, и send
+    // вызывается асинхронно. accept_websocket задан для запросов на установку
+    // WebSocket-соединения
+    void operator()(http_server::StringRequest&& req, Sender send,
+                    http_server::WebSocketAccept accept_websocket = {});
+
+    // Задаёт копию подготовленных ответов, которую использует текущий поток.
+    // Рабочий поток, привязанный к процессорному сокету, получает копию, размещённую в памяти
+    // этого сокета. nullptr возвращает поток к общей копии. responses должен пережить поток
+    static void UseLocalMapResponses(const MapResponses* responses) noexcept {
+        local_map_responses_ = responses;
+    }
+
+    // Обработчик служебных запросов. Вызывается только для соединений, принятых
+    // служебным листенером, а не листенерами игроков
+    void HandleAdminRequest(http_server::StringRequest&& req, Sender send);
+
+    // Включает служебный эндпоинт /api/v1/admin/trace для управления трассировкой
+    // и выгрузки трасс. nullptr выключает его
+    void SetTracer(tracing::Tracer* tracer) noexcept {
+        tracer_ = tracer;
+    }
 
 private:
     model::Game& game_;
+    app::Application& app_;
+    StateBroadcaster& broadcaster_;
+    // Ответы на запросы карт, подготовленные при создании обработчика
+    MapResponses map_responses_;
+    static thread_local const MapResponses* local_map_responses_;
+    tracing::Tracer* tracer_ = nullptr;
+
+    const MapResponses& GetMapResponses() const noexcept {
+        return local_map_responses_ ? *local_map_responses_ : map_responses_;
+    }
 
     // Обработчики конкретных эндпоинтов
-    http_server::StringResponse HandleApiMaps(const http_server::StringRequest& req);
-    http_server::StringResponse HandleApiMap(const http_server::StringRequest& req);
+    http_server::SharedStringResponse HandleApiMaps(const http_server::StringRequest& req);
+    void HandleApiMap(const http_server::StringRequest& req, std::string_view map_id, const Sender& send);
+    void HandleJoinGame(const http_server::StringRequest& req, Sender send);
+    void HandleGetPlayers(const http_server::StringRequest& req, Sender send);
+    void HandleStateSubscription(http_server::StringRequest&& req, Sender send,
+                                 http_server::WebSocketAccept accept_websocket);
+    http_server::StringResponse HandleAdminTrace(const http_server::StringRequest& req);
     
     // Вспомогательные методы для формирования ответов
     http_server::StringResponse MakeJsonResponse(http::status status, std::string_view code, std::string_view message);
+    http_server::StringResponse MakeNoCacheJsonResponse(std::string body);
     http_server::StringResponse MakeBadRequestResponse(std::string_view message = "Bad request");
     http_server::StringResponse MakeMapNotFoundResponse(std::string_view message = "Map not found");
     http_server::StringResponse MakeMethodNotAllowedResponse(std::string_view message = "Method not allowed");
+    http_server::StringResponse MakeInternalErrorResponse(std::string_view message = "Internal server error");
+    http_server::StringResponse MakeUnauthorizedResponse(std::string_view code, std::string_view message);
+    
+    // Проверяет, запросил ли клиент двоичное представление карты в заголовке Accept
+    static bool AcceptsBinaryMap(const http_server::StringRequest& req);
+
+    // Возвращает путь из request-target без строки запроса и фрагмента
+    static std::string_view GetTargetPath(std::string_view target) noexcept;
+    
+    // Извлекает токен из заголовка Authorization: Bearer <token>.
+    // Возвращает string_view на данные запроса, память не выделяется
+    static std::optional<std::string_view> TryExtractToken(const http_server::StringRequest& req);
     
     // Проверка поддерживаемых методов
     bool IsValidMethod(http::verb method, const std::vector<http::verb>& allowed_methods);
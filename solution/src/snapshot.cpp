@@ -0,0 +1,203 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+namespace persistence {
+using namespace std::literals;
+
+namespace {
+
+constexpr std::string_view SNAPSHOT_MAGIC = "GSNP"sv;
+constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+
+std::string SerializeState(const app::GameState& state) {
+    binary_io::BinaryWriter writer;
+    writer.WriteBytes(SNAPSHOT_MAGIC);
+    writer.Write(SNAPSHOT_VERSION);
+    writer.Write(state.next_player_id);
+    writer.Write(static_cast<std::uint64_t>(state.players.size()));
+    for (const auto& player : state.players) {
+        SerializePlayerState(writer, player);
+    }
+    return std::move(writer.GetBuffer());
+}
+
+app::GameState DeserializeState(std::string_view data) {
+    binary_io::BinaryReader reader{data};
+    if (reader.ReadBytes(SNAPSHOT_MAGIC.size()) != SNAPSHOT_MAGIC) {
+        throw std::runtime_error("Invalid snapshot signature");
+    }
+    if (reader.Read<std::uint32_t>() != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version");
+    }
+
+    app::GameState state;
+    state.next_player_id = reader.Read<std::uint64_t>();
+    const auto players_count = reader.Read<std::uint64_t>();
+    for (std::uint64_t i = 0; i < players_count; ++i) {
+        state.players.push_back(DeserializePlayerState(reader));
+    }
+    if (!reader.IsEnd()) {
+        throw std::runtime_error("Unexpected data at the end of snapshot");
+    }
+    return state;
+}
+
+// Записывает данные в файл и сбрасывает их на диск
+void WriteFileSync(const std::filesystem::path& path, std::string_view data) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + path.string());
+    }
+    while (!data.empty()) {
+        const ssize_t written = ::write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Failed to write " + path.string());
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    if (::fsync(fd) != 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Failed to sync " + path.string());
+    }
+    ::close(fd);
+}
+
+}  // namespace
+
+void SyncDirectory(const std::filesystem::path& dir) {
+    const std::filesystem::path path = dir.empty() ? std::filesystem::path{"."} : dir;
+    const int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + path.string());
+    }
+    if (::fsync(fd) != 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Failed to sync " + path.string());
+    }
+    ::close(fd);
+}
+
+void SerializePlayerState(binary_io::BinaryWriter& writer, const app::PlayerState& player) {
+    writer.Write(*player.id);
+    writer.WriteBytes(*player.token);
+    writer.WriteString(player.name);
+    writer.WriteString(*player.map_id);
+    writer.Write(player.position.x);
+    writer.Write(player.position.y);
+}
+
+app::PlayerState DeserializePlayerState(binary_io::BinaryReader& reader) {
+    app::Player::Id id{reader.Read<std::uint64_t>()};
+    app::Token token{std::string{reader.ReadBytes(app::TOKEN_LENGTH)}};
+    std::string name = reader.ReadString();
+    const std::string map_id_str = reader.ReadString();
+    if (!model::IdString::Fits(map_id_str)) {
+        throw std::runtime_error("Invalid map id in saved state");
+    }
+    model::Map::Id map_id{model::IdString{map_id_str}};
+    const auto x = reader.Read<model::Coord>();
+    const auto y = reader.Read<model::Coord>();
+    return {id, std::move(token), std::move(name), std::move(map_id), {x, y}};
+}
+
+void WriteSnapshot(const app::GameState& state, const std::filesystem::path& path) {
+    const std::string data = SerializeState(state);
+
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+    WriteFileSync(temp_path, data);
+    std::filesystem::rename(temp_path, path);
+    SyncDirectory(path.parent_path());
+}
+
+std::optional<app::GameState> ReadSnapshot(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return DeserializeState(buffer.str());
+}
+
+SnapshotWriter::SnapshotWriter(std::filesystem::path path)
+    : path_{std::move(path)}
+    , thread_{[this](std::stop_token stop_token) {
+        Run(stop_token);
+    }} {
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    Stop();
+}
+
+void SnapshotWriter::Submit(app::GameState state, std::chrono::nanoseconds collect_pause, SavedHandler on_saved) {
+    {
+        std::lock_guard lock{mutex_};
+        pending_ = std::move(state);
+        pending_pause_ = collect_pause;
+        pending_on_saved_ = std::move(on_saved);
+    }
+    cv_.notify_one();
+}
+
+void SnapshotWriter::Stop() {
+    if (thread_.joinable()) {
+        thread_.request_stop();
+        thread_.join();
+    }
+}
+
+void SnapshotWriter::Run(std::stop_token stop_token) {
+    for (;;) {
+        app::GameState state;
+        std::chrono::nanoseconds collect_pause;
+        SavedHandler on_saved;
+        {
+            std::unique_lock lock{mutex_};
+            // При остановке дожидаемся записи последнего снимка
+            if (!cv_.wait(lock, stop_token, [this] {
+                    return pending_.has_value();
+                })) {
+                return;
+            }
+            state = std::move(*pending_);
+            collect_pause = pending_pause_;
+            on_saved = std::move(pending_on_saved_);
+            pending_.reset();
+        }
+
+        using namespace std::chrono;
+        try {
+            const auto start = steady_clock::now();
+            WriteSnapshot(state, path_);
+            const auto write_time = steady_clock::now() - start;
+            std::cout << "State saved: players="sv << state.players.size()
+                      << " pause_us="sv << duration_cast<microseconds>(collect_pause).count()
+                      << " write_us="sv << duration_cast<microseconds>(write_time).count() << std::endl;
+            if (on_saved) {
+                on_saved();
+            }
+        } catch (const std::exception& ex) {
+            std::cerr << "Failed to save state: "sv << ex.what() << std::endl;
+        }
+    }
+}
+
+}  // namespace persistence
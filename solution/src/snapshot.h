@@ -0,0 +1,78 @@
+#pragma once
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+
+#include "application.h"
+#include "binary_io.h"
+
+namespace persistence {
+
+/*
+ * Формат файла снимка состояния (все числа little-endian):
+ *
+ *  char[4]  magic = "GSNP"
+ *  uint32   version
+ *  uint64   next_player_id
+ *  uint64   players_count
+ *  players_count раз PlayerState:
+ *      uint64   player_id
+ *      char[32] token
+ *      string   name         (uint32 длина + байты)
+ *      string   map_id       (uint32 длина + байты)
+ *      int32    x, y         (позиция собаки)
+ */
+
+// Сбрасывает на диск записи каталога dir, чтобы созданные и переименованные в нём файлы
+// пережили сбой. Выбрасывает std::system_error в случае ошибки
+void SyncDirectory(const std::filesystem::path& dir);
+
+void SerializePlayerState(binary_io::BinaryWriter& writer, const app::PlayerState& player);
+app::PlayerState DeserializePlayerState(binary_io::BinaryReader& reader);
+
+// Сериализует состояние и атомарно записывает его в файл:
+// данные пишутся во временный файл, сбрасываются на диск и переименовываются в path
+void WriteSnapshot(const app::GameState& state, const std::filesystem::path& path);
+
+// Читает снимок состояния. Возвращает std::nullopt, если файла нет.
+// Выбрасывает std::runtime_error, если файл повреждён
+std::optional<app::GameState> ReadSnapshot(const std::filesystem::path& path);
+
+// Записывает снимки в отдельном потоке, чтобы не задерживать потоки io_context.
+// Хранит не более одного ожидающего снимка: если предыдущий ещё не начал записываться,
+// он заменяется более свежим
+class SnapshotWriter {
+public:
+    // Вызывается в потоке SnapshotWriter после успешной записи снимка
+    using SavedHandler = std::function<void()>;
+
+    explicit SnapshotWriter(std::filesystem::path path);
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Ставит снимок в очередь на запись. Не блокирует вызывающий поток на время записи
+    void Submit(app::GameState state, std::chrono::nanoseconds collect_pause, SavedHandler on_saved = {});
+
+    // Дожидается записи ожидающего снимка и останавливает поток
+    void Stop();
+
+    ~SnapshotWriter();
+
+private:
+    void Run(std::stop_token stop_token);
+
+    std::filesystem::path path_;
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::optional<app::GameState> pending_;
+    std::chrono::nanoseconds pending_pause_{0};
+    SavedHandler pending_on_saved_;
+    std::jthread thread_;
+};
+
+}  // namespace persistence
@@ -0,0 +1,97 @@
+#include "state_broadcaster.h"
+
+#include <boost/json.hpp>
+
+namespace http_handler {
+
+namespace net = boost::asio;
+namespace json = boost::json;
+using namespace std::literals;
+
+namespace {
+
+template <typename DogIt>
+std::string SerializeSessionState(std::string_view type, std::uint64_t tick, DogIt begin, DogIt end) {
+    json::object players_obj;
+    for (auto it = begin; it != end; ++it) {
+        json::object player_obj;
+        player_obj["name"] = it->GetName();
+        player_obj["pos"] = json::array{it->GetPosition().x, it->GetPosition().y};
+        players_obj[std::to_string(*it->GetId())] = std::move(player_obj);
+    }
+
+    json::object message;
+    message["type"] = json::string(type.data(), type.size());
+    message["tick"] = tick;
+    message["players"] = std::move(players_obj);
+    return json::serialize(message);
+}
+
+}  // namespace
+
+StateBroadcaster::StateBroadcaster(app::Application& app)
+    : app_{app} {
+    // Записи для всех сеансов создаются заранее, дальше каждая из них меняется только на strand своего сеанса
+    for (const auto& map : app_.GetGame().GetMaps()) {
+        sessions_.emplace(map.GetId(), SessionSubscribers{});
+    }
+}
+
+void StateBroadcaster::Subscribe(const app::Player& player, Subscriber subscriber) {
+    const model::GameSession& session = player.GetSession();
+    SessionSubscribers& entry = sessions_.at(session.GetMap().GetId());
+
+    const auto& dogs = session.GetDogs();
+    auto message = std::make_shared<const std::string>(
+        SerializeSessionState("state"sv, entry.tick, dogs.begin(), dogs.end()));
+    if (subscriber->Send(std::move(message))) {
+        entry.subscribers.push_back({std::move(subscriber), dogs.size()});
+    }
+}
+
+void StateBroadcaster::Tick() {
+    for (auto& [map_id, entry] : sessions_) {
+        net::post(app_.GetSessionStrand(map_id), [this, &map_id = map_id, &entry = entry] {
+            BroadcastSessionDelta(map_id, entry);
+        });
+    }
+}
+
+void StateBroadcaster::BroadcastSessionDelta(const model::Map::Id& map_id, SessionSubscribers& entry) {
+    const auto& dogs = app_.GetSession(map_id).GetDogs();
+    ++entry.tick;
+
+    // Закрытые соединения отпускаем каждый тик, даже если рассылать нечего
+    std::erase_if(entry.subscribers, [](const SubscriberEntry& subscriber) {
+        return subscriber.connection->IsClosed();
+    });
+
+    // Сообщение сериализуется один раз и разделяется между всеми подписчиками, которым известно
+    // одно и то же число собак. Отдельное сообщение нужно только подписавшимся после прошлого тика:
+    // часть новых собак они уже получили в полном состоянии
+    std::shared_ptr<const std::string> message;
+    size_t message_first_dog = 0;
+    bool has_failed = false;
+    for (auto& subscriber : entry.subscribers) {
+        if (subscriber.reported_dogs == dogs.size()) {
+            continue;
+        }
+        if (!message || message_first_dog != subscriber.reported_dogs) {
+            message_first_dog = subscriber.reported_dogs;
+            message = std::make_shared<const std::string>(
+                SerializeSessionState("delta"sv, entry.tick, dogs.begin() + message_first_dog, dogs.end()));
+        }
+        subscriber.reported_dogs = dogs.size();
+        if (!subscriber.connection->Send(message)) {
+            subscriber.connection.reset();
+            has_failed = true;
+        }
+    }
+    if (has_failed) {
+        std::erase_if(entry.subscribers, [](const SubscriberEntry& subscriber) {
+            return !subscriber.connection;
+        });
+    }
+}
+
+}  // namespace http_handler
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "application.h"
+#include "http_server.h"
+#include "model.h"
+
+namespace http_handler {
+
+// Рассылает подписчикам изменения состояния игровых сеансов.
+// Изменения сеанса сериализуются один раз за тик, и одно и то же сообщение
+// отправляется всем подписчикам сеанса.
+//
+// Формат сообщений (JSON):
+//  {"type": "state", "tick": N, "players": {"<id>": {"name": "...", "pos": [x, y]}, ...}}
+//      текущее состояние сеанса целиком, отправляется при подписке
+//  {"type": "delta", "tick": N, "players": {...}}
+//      игроки, появившиеся в сеансе с предыдущего тика и ещё не отправленные подписчику
+// Подписчики с закрытыми соединениями отпускаются на каждом тике.
+class StateBroadcaster {
+public:
+    using Subscriber = std::shared_ptr<http_server::WebSocketConnection>;
+
+    explicit StateBroadcaster(app::Application& app);
+
+    StateBroadcaster(const StateBroadcaster&) = delete;
+    StateBroadcaster& operator=(const StateBroadcaster&) = delete;
+
+    // Подписывает на изменения сеанса, в котором находится игрок, и отправляет
+    // подписчику текущее состояние сеанса. Вызывается на strand игрового сеанса
+    void Subscribe(const app::Player& player, Subscriber subscriber);
+
+    // Рассылает изменения всех сеансов. Каждый сеанс обрабатывается на своём strand
+    void Tick();
+
+private:
+    struct SubscriberEntry {
+        Subscriber connection;
+        // Число собак сеанса, о которых подписчик уже уведомлён
+        size_t reported_dogs = 0;
+    };
+
+    struct SessionSubscribers {
+        // Упорядочены по времени подписки, поэтому reported_dogs не убывает
+        std::vector<SubscriberEntry> subscribers;
+        std::uint64_t tick = 0;
+    };
+
+    using MapIdHasher = util::TaggedHasher<model::Map::Id>;
+    using Sessions = std::unordered_map<model::Map::Id, SessionSubscribers, MapIdHasher>;
+
+    void BroadcastSessionDelta(const model::Map::Id& map_id, SessionSubscribers& entry);
+
+    app::Application& app_;
+    Sessions sessions_;
+};
+
+}  // namespace http_handler
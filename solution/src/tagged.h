@@ -1,5 +1,8 @@
 #pragma once
 #include <compare>
+#include <concepts>
+#include <functional>
+#include <utility>
 
 namespace util {
 
@@ -31,18 +34,18 @@ public:
     using ValueType = Value;
     using TagType = Tag;
 
-    explicit Tagged(Value&& v)
+    constexpr explicit Tagged(Value&& v)
         : value_(std::move(v)) {
     }
-    explicit Tagged(const Value& v)
+    constexpr explicit Tagged(const Value& v)
         : value_(v) {
     }
 
-    const Value& operator*() const {
+    constexpr const Value& operator*() const {
         return value_;
     }
 
-    Value& operator*() {
+    constexpr Value& operator*() {
         return value_;
     }
 
@@ -54,12 +57,22 @@ private:
     Value value_;
 };
 
+// Значение, хранящее заранее вычисленный хеш (например, util::FixedString)
+template <typename Value>
+concept HasCachedHash = requires(const Value& value) {
+    { value.Hash() } -> std::convertible_to<size_t>;
+};
+
 // Хешер для Tagged-типа, чтобы Tagged-объекты можно было хранить в unordered-контейнерах
 template <typename TaggedValue>
 struct TaggedHasher {
     size_t operator()(const TaggedValue& value) const {
         // Возвращает хеш значения, хранящегося внутри value
-        return std::hash<typename TaggedValue::ValueType>{}(*value);
+        if constexpr (HasCachedHash<typename TaggedValue::ValueType>) {
+            return (*value).Hash();
+        } else {
+            return std::hash<typename TaggedValue::ValueType>{}(*value);
+        }
     }
 };
 
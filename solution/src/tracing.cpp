@@ -0,0 +1,141 @@
+#include "tracing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <system_error>
+
+namespace tracing {
+
+namespace {
+
+thread_local TraceContext current_trace;
+
+// Время в Chrome Trace Event задаётся в микросекундах.
+// Отрицательное значение (конец интервала взят раньше начала) выводится как 0:
+// иначе остаток от деления дал бы строку вида -0.-12, недопустимую в JSON
+void AppendMicroseconds(std::string& out, std::int64_t ns) {
+    ns = std::max<std::int64_t>(ns, 0);
+    out += std::to_string(ns / 1000);
+    out += '.';
+    out += std::to_string(1000 + ns % 1000).substr(1);
+}
+
+}  // namespace
+
+thread_local const Tracer* Tracer::buffer_owner_ = nullptr;
+thread_local Tracer::ThreadBuffer* Tracer::thread_buffer_ = nullptr;
+
+Tracer::Tracer(unsigned sample_every)
+    : sample_every_{sample_every} {
+}
+
+Tracer::ThreadBuffer& Tracer::GetThreadBuffer() {
+    if (buffer_owner_ != this) {
+        // Первый интервал, записываемый потоком: создаём его буфер
+        std::lock_guard lock{mutex_};
+        auto buffer = std::make_unique<ThreadBuffer>(static_cast<unsigned>(buffers_.size()));
+        thread_buffer_ = buffer.get();
+        buffer_owner_ = this;
+        buffers_.push_back(std::move(buffer));
+    }
+    return *thread_buffer_;
+}
+
+void Tracer::Record(const char* name, std::uint64_t trace_id, Clock::time_point start,
+                    Clock::time_point end) noexcept {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+
+    ThreadBuffer* buffer = nullptr;
+    try {
+        buffer = &GetThreadBuffer();
+    } catch (...) {
+        // Интервал теряется, если не удалось выделить буфер
+        return;
+    }
+
+    const std::uint64_t index = buffer->head.load(std::memory_order_relaxed);
+    Slot& slot = buffer->slots[index % BUFFER_CAPACITY];
+    // Нечётная версия означает, что ячейка изменяется
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.trace_id.store(trace_id, std::memory_order_relaxed);
+    slot.start_ns.store(duration_cast<nanoseconds>(start - origin_).count(), std::memory_order_relaxed);
+    slot.duration_ns.store(duration_cast<nanoseconds>(end - start).count(), std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+std::string Tracer::ExportChromeTrace() const {
+    std::string result = R"({"displayTimeUnit":"ms","traceEvents":[)";
+    bool first = true;
+
+    std::lock_guard lock{mutex_};
+    for (const auto& buffer : buffers_) {
+        const std::uint64_t head = buffer->head.load(std::memory_order_acquire);
+        const std::uint64_t begin = head > BUFFER_CAPACITY ? head - BUFFER_CAPACITY : 0;
+        for (std::uint64_t index = begin; index < head; ++index) {
+            const Slot& slot = buffer->slots[index % BUFFER_CAPACITY];
+            const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * index + 2) {
+                // Ячейка уже перезаписана более новым интервалом
+                continue;
+            }
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            const std::uint64_t trace_id = slot.trace_id.load(std::memory_order_relaxed);
+            const std::int64_t start_ns = slot.start_ns.load(std::memory_order_relaxed);
+            const std::int64_t duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+
+            if (!first) {
+                result += ',';
+            }
+            first = false;
+            result += R"({"name":")";
+            result += name;
+            result += R"(","cat":"http","ph":"X","pid":1,"tid":)";
+            result += std::to_string(buffer->thread_index);
+            result += R"(,"ts":)";
+            AppendMicroseconds(result, start_ns);
+            result += R"(,"dur":)";
+            AppendMicroseconds(result, duration_ns);
+            result += R"(,"args":{"trace":)";
+            result += std::to_string(trace_id);
+            result += "}}";
+        }
+    }
+    result += "]}";
+    return result;
+}
+
+void Tracer::DumpChromeTrace(const std::filesystem::path& path) const {
+    const std::string trace = ExportChromeTrace();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + path.string());
+    }
+    file << trace;
+    if (!file.flush()) {
+        throw std::system_error(errno, std::generic_category(), "Failed to write " + path.string());
+    }
+}
+
+TraceContext GetCurrentTrace() noexcept {
+    return current_trace;
+}
+
+TraceScope::TraceScope(TraceContext context) noexcept
+    : previous_{current_trace} {
+    current_trace = context;
+}
+
+TraceScope::~TraceScope() {
+    current_trace = previous_;
+}
+
+}  // namespace tracing
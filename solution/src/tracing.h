@@ -0,0 +1,157 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tracing {
+
+using Clock = std::chrono::steady_clock;
+
+// Выборочная трассировка запросов.
+// Трассируется каждый N-й запрос; у трассы есть идентификатор, а её интервалы (spans)
+// записываются в кольцевые буферы потоков без блокировок. Выгружаются интервалы
+// в формате Chrome Trace Event (chrome://tracing, Perfetto).
+// Если трассировка выключена, проверка стоит одно чтение атомарной переменной
+class Tracer {
+public:
+    // Сколько последних интервалов хранит буфер одного потока
+    static constexpr size_t BUFFER_CAPACITY = 4096;
+
+    // sample_every = 0 выключает трассировку
+    explicit Tracer(unsigned sample_every = 0);
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // Трассировать каждый sample_every-й запрос. 0 выключает трассировку
+    void SetSampleEvery(unsigned sample_every) noexcept {
+        sample_every_.store(sample_every, std::memory_order_relaxed);
+    }
+
+    unsigned GetSampleEvery() const noexcept {
+        return sample_every_.load(std::memory_order_relaxed);
+    }
+
+    // Решает, трассировать ли очередной запрос.
+    // Возвращает идентификатор новой трассы или 0, если запрос не трассируется
+    std::uint64_t StartTrace() noexcept {
+        const unsigned sample_every = sample_every_.load(std::memory_order_relaxed);
+        if (sample_every == 0) {
+            return 0;
+        }
+        // Счётчик у каждого потока свой, чтобы не делить кэш-линию между потоками
+        thread_local unsigned counter = 0;
+        if (++counter < sample_every) {
+            return 0;
+        }
+        counter = 0;
+        return next_trace_id_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Записывает интервал name трассы trace_id в буфер текущего потока.
+    // name должен указывать на строку со статическим временем жизни
+    void Record(const char* name, std::uint64_t trace_id, Clock::time_point start, Clock::time_point end) noexcept;
+
+    // Возвращает записанные интервалы в формате Chrome Trace Event (JSON)
+    std::string ExportChromeTrace() const;
+
+    // Записывает интервалы в файл в формате Chrome Trace Event
+    void DumpChromeTrace(const std::filesystem::path& path) const;
+
+private:
+    // Ячейка кольцевого буфера, защищённая счётчиком версий (seqlock):
+    // пишет только поток-владелец, читатель отбрасывает ячейки, изменённые во время чтения
+    struct Slot {
+        std::atomic<std::uint64_t> sequence{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<std::uint64_t> trace_id{0};
+        std::atomic<std::int64_t> start_ns{0};
+        std::atomic<std::int64_t> duration_ns{0};
+    };
+
+    struct ThreadBuffer {
+        explicit ThreadBuffer(unsigned thread_index) noexcept
+            : thread_index{thread_index} {
+        }
+
+        const unsigned thread_index;
+        std::atomic<std::uint64_t> head{0};
+        std::array<Slot, BUFFER_CAPACITY> slots;
+    };
+
+    ThreadBuffer& GetThreadBuffer();
+
+    std::atomic<unsigned> sample_every_;
+    std::atomic<std::uint64_t> next_trace_id_{1};
+    const Clock::time_point origin_ = Clock::now();
+
+    // Буферы принадлежат трассировщику и переживают свои потоки
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+
+    // Буфер текущего потока и трассировщик, которому он принадлежит
+    static thread_local const Tracer* buffer_owner_;
+    static thread_local ThreadBuffer* thread_buffer_;
+};
+
+// Трасса, к которой относится код, выполняемый в текущем потоке
+struct TraceContext {
+    Tracer* tracer = nullptr;
+    std::uint64_t trace_id = 0;
+
+    explicit operator bool() const noexcept {
+        return trace_id != 0;
+    }
+};
+
+// Возвращает трассу текущего потока. Её можно сохранить в обработчике,
+// выполняемом позже на другом strand, и восстановить там с помощью TraceScope
+TraceContext GetCurrentTrace() noexcept;
+
+// Делает context трассой текущего потока до конца области видимости
+class TraceScope {
+public:
+    explicit TraceScope(TraceContext context) noexcept;
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceContext previous_;
+};
+
+// Записывает интервал name от создания до разрушения объекта,
+// если текущий поток выполняет трассируемый запрос
+class ScopedSpan {
+public:
+    explicit ScopedSpan(const char* name) noexcept
+        : name_{name}
+        , context_{GetCurrentTrace()} {
+        if (context_) {
+            start_ = Clock::now();
+        }
+    }
+
+    ~ScopedSpan() {
+        if (context_) {
+            context_.tracer->Record(name_, context_.trace_id, start_, Clock::now());
+        }
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+private:
+    const char* name_;
+    TraceContext context_;
+    Clock::time_point start_;
+};
+
+}  // namespace tracing
@@ -0,0 +1,279 @@
+#include "traffic_capture.h"
+
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+#include "binary_io.h"
+
+namespace traffic {
+using namespace std::literals;
+
+namespace {
+
+constexpr std::string_view CAPTURE_MAGIC = "GTRC"sv;
+constexpr std::uint32_t CAPTURE_VERSION = 2;
+// Записи версии 1 отличаются только отсутствием тел ответов
+constexpr std::uint32_t CAPTURE_VERSION_WITHOUT_BODIES = 1;
+constexpr std::uint8_t REQUEST_RECORD = 1;
+constexpr std::uint8_t RESPONSE_RECORD = 2;
+
+// Размер буфера, при заполнении которого записи передаются потоку записи
+constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+// Наибольшее число заполненных буферов, ожидающих записи (16 МиБ)
+constexpr size_t MAX_PENDING_BUFFERS = 256;
+
+constexpr std::string_view BEARER_PREFIX = "Bearer "sv;
+// Поле с токеном в ответе на вход в игру. Ответ сериализуется boost::json без пробелов
+constexpr std::string_view AUTH_TOKEN_FIELD = "\"authToken\":\""sv;
+
+}  // namespace
+
+std::uint64_t HashBody(std::string_view body) noexcept {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : body) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+Capture ReadCapture(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string data = buffer.str();
+
+    binary_io::BinaryReader reader{data};
+    if (reader.ReadBytes(CAPTURE_MAGIC.size()) != CAPTURE_MAGIC) {
+        throw std::runtime_error("Invalid capture signature");
+    }
+    const auto version = reader.Read<std::uint32_t>();
+    if (version != CAPTURE_VERSION && version != CAPTURE_VERSION_WITHOUT_BODIES) {
+        throw std::runtime_error("Unsupported capture version");
+    }
+
+    Capture capture;
+    while (!reader.IsEnd()) {
+        const auto type = reader.Read<std::uint8_t>();
+        if (type == REQUEST_RECORD) {
+            RequestRecord record;
+            record.connection_id = reader.Read<std::uint64_t>();
+            record.request_index = reader.Read<std::uint64_t>();
+            record.timestamp = std::chrono::nanoseconds{reader.Read<std::uint64_t>()};
+            record.method = reader.ReadString();
+            record.target = reader.ReadString();
+            const auto headers_count = reader.Read<std::uint32_t>();
+            for (std::uint32_t i = 0; i < headers_count; ++i) {
+                std::string name = reader.ReadString();
+                std::string value = reader.ReadString();
+                record.headers.emplace_back(std::move(name), std::move(value));
+            }
+            record.body = reader.ReadString();
+            capture.requests.push_back(std::move(record));
+        } else if (type == RESPONSE_RECORD) {
+            ResponseRecord record;
+            record.connection_id = reader.Read<std::uint64_t>();
+            record.request_index = reader.Read<std::uint64_t>();
+            record.timestamp = std::chrono::nanoseconds{reader.Read<std::uint64_t>()};
+            record.status = reader.Read<std::uint32_t>();
+            record.body_hash = reader.Read<std::uint64_t>();
+            if (version != CAPTURE_VERSION_WITHOUT_BODIES && reader.Read<std::uint8_t>() != 0) {
+                record.body = reader.ReadString();
+            }
+            capture.responses.push_back(std::move(record));
+        } else {
+            throw std::runtime_error("Unknown capture record type");
+        }
+    }
+    return capture;
+}
+
+TrafficRecorder::TrafficRecorder(const std::filesystem::path& path) {
+    if (RAND_bytes(token_salt_.data(), static_cast<int>(token_salt_.size())) != 1) {
+        throw std::runtime_error("Failed to generate traffic capture salt");
+    }
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + path.string());
+    }
+    binary_io::BinaryWriter writer;
+    writer.WriteBytes(CAPTURE_MAGIC);
+    writer.Write(CAPTURE_VERSION);
+    Append(writer.GetBuffer());
+
+    thread_ = std::jthread{[this](std::stop_token stop_token) {
+        Run(stop_token);
+    }};
+}
+
+TrafficRecorder::~TrafficRecorder() {
+    {
+        std::lock_guard lock{mutex_};
+        if (!buffer_.empty()) {
+            full_buffers_.push_back(std::move(buffer_));
+        }
+    }
+    // Поток дописывает оставшиеся буферы и завершается
+    thread_.request_stop();
+    thread_.join();
+    ::close(fd_);
+    if (dropped_bytes_ > 0) {
+        std::cerr << "Traffic capture: dropped "sv << dropped_bytes_ << " bytes, disk is too slow"sv << std::endl;
+    }
+}
+
+void TrafficRecorder::RecordRequest(std::uint64_t connection_id, std::uint64_t request_index,
+                                    const http::request<http::string_body>& request) {
+    // Запись формируется вне блокировки, под блокировкой только копируется в буфер
+    binary_io::BinaryWriter writer;
+    writer.Write(REQUEST_RECORD);
+    writer.Write(connection_id);
+    writer.Write(request_index);
+    writer.Write(static_cast<std::uint64_t>(GetTimestamp().count()));
+    writer.WriteString(request.method_string());
+    writer.WriteString(request.target());
+
+    std::uint32_t headers_count = 0;
+    for ([[maybe_unused]] const auto& field : request) {
+        ++headers_count;
+    }
+    writer.Write(headers_count);
+    for (const auto& field : request) {
+        writer.WriteString(field.name_string());
+        const std::string_view value = field.value();
+        if (field.name() == http::field::authorization && value.starts_with(BEARER_PREFIX)) {
+            writer.WriteString(std::string{BEARER_PREFIX} + PseudonymizeToken(value.substr(BEARER_PREFIX.size())));
+        } else {
+            writer.WriteString(value);
+        }
+    }
+    writer.WriteString(request.body());
+    Append(writer.GetBuffer());
+}
+
+void TrafficRecorder::RecordResponse(std::uint64_t connection_id, std::uint64_t request_index, unsigned status,
+                                     std::string_view body) {
+    std::string redacted_body;
+    if (body.find(AUTH_TOKEN_FIELD) != std::string_view::npos) {
+        redacted_body = RedactResponseBody(body);
+        body = redacted_body;
+    }
+
+    binary_io::BinaryWriter writer;
+    writer.Write(RESPONSE_RECORD);
+    writer.Write(connection_id);
+    writer.Write(request_index);
+    writer.Write(static_cast<std::uint64_t>(GetTimestamp().count()));
+    writer.Write(static_cast<std::uint32_t>(status));
+    writer.Write(HashBody(body));
+    const bool has_body = body.size() <= MAX_CAPTURED_BODY_SIZE;
+    writer.Write(static_cast<std::uint8_t>(has_body));
+    if (has_body) {
+        writer.WriteString(body);
+    }
+    Append(writer.GetBuffer());
+}
+
+std::string TrafficRecorder::PseudonymizeToken(std::string_view token) const {
+    std::array<unsigned char, EVP_MAX_MD_SIZE> digest{};
+    unsigned digest_size = 0;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    const bool ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) == 1
+                    && EVP_DigestUpdate(ctx, token_salt_.data(), token_salt_.size()) == 1
+                    && EVP_DigestUpdate(ctx, token.data(), token.size()) == 1
+                    && EVP_DigestFinal_ex(ctx, digest.data(), &digest_size) == 1;
+    EVP_MD_CTX_free(ctx);
+    if (!ok) {
+        throw std::runtime_error("Failed to hash player token");
+    }
+
+    constexpr char HEX_DIGITS[] = "0123456789abcdef";
+    std::string pseudonym;
+    pseudonym.reserve(32);
+    for (size_t i = 0; i < 16; ++i) {
+        pseudonym += HEX_DIGITS[digest[i] >> 4];
+        pseudonym += HEX_DIGITS[digest[i] & 0xF];
+    }
+    return pseudonym;
+}
+
+std::string TrafficRecorder::RedactResponseBody(std::string_view body) const {
+    std::string result;
+    for (;;) {
+        const auto field_pos = body.find(AUTH_TOKEN_FIELD);
+        const auto value_pos = field_pos == std::string_view::npos ? field_pos : field_pos + AUTH_TOKEN_FIELD.size();
+        const auto end_pos = value_pos == std::string_view::npos ? value_pos : body.find('"', value_pos);
+        if (end_pos == std::string_view::npos) {
+            result.append(body);
+            return result;
+        }
+        result.append(body.substr(0, value_pos));
+        result.append(PseudonymizeToken(body.substr(value_pos, end_pos - value_pos)));
+        body.remove_prefix(end_pos);
+    }
+}
+
+void TrafficRecorder::Append(std::string_view data) {
+    {
+        std::lock_guard lock{mutex_};
+        buffer_.append(data);
+        if (buffer_.size() < FLUSH_THRESHOLD) {
+            return;
+        }
+        // Под блокировкой буфер только передаётся потоку записи
+        if (full_buffers_.size() < MAX_PENDING_BUFFERS) {
+            full_buffers_.push_back(std::move(buffer_));
+        } else {
+            dropped_bytes_ += buffer_.size();
+        }
+        buffer_ = {};
+        buffer_.reserve(FLUSH_THRESHOLD);
+    }
+    cv_.notify_one();
+}
+
+void TrafficRecorder::Run(std::stop_token stop_token) {
+    for (;;) {
+        std::vector<std::string> buffers;
+        {
+            std::unique_lock lock{mutex_};
+            // При остановке дописываем все заполненные буферы
+            if (!cv_.wait(lock, stop_token, [this] {
+                    return !full_buffers_.empty();
+                })) {
+                return;
+            }
+            buffers.swap(full_buffers_);
+        }
+        for (const auto& buffer : buffers) {
+            WriteBuffer(buffer);
+        }
+    }
+}
+
+void TrafficRecorder::WriteBuffer(std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = ::write(fd_, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Traffic capture write failed: "sv << std::generic_category().message(errno) << std::endl;
+            break;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+}  // namespace traffic
@@ -0,0 +1,131 @@
+#pragma once
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/beast/http.hpp>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace traffic {
+
+namespace http = boost::beast::http;
+
+// Наибольший размер тела ответа, сохраняемого в записи трафика целиком
+constexpr size_t MAX_CAPTURED_BODY_SIZE = 4096;
+
+/*
+ * Формат файла записи трафика (все числа little-endian):
+ *
+ *  char[4]  magic = "GTRC"
+ *  uint32   version
+ *  далее записи, каждая начинается с uint8 type:
+ *
+ *  type = 1, запрос:
+ *      uint64   connection_id
+ *      uint64   request_index   (номер запроса в соединении)
+ *      uint64   timestamp_ns    (от начала записи)
+ *      string   method          (uint32 длина + байты)
+ *      string   target
+ *      uint32   headers_count
+ *      headers_count раз: string name, string value
+ *      string   body
+ *
+ *  type = 2, ответ:
+ *      uint64   connection_id
+ *      uint64   request_index
+ *      uint64   timestamp_ns
+ *      uint32   status
+ *      uint64   body_hash       (FNV-1a)
+ *      uint8    has_body        (с версии 2)
+ *      string   body            (с версии 2, если has_body = 1)
+ *
+ * Тело ответа сохраняется, только если оно не длиннее MAX_CAPTURED_BODY_SIZE: по нему при
+ * воспроизведении сопоставляются игроки, а большие ответы (например, карты) сравниваются по хешу.
+ *
+ * Токены игроков в файл не попадают: значение заголовка Authorization: Bearer и поле authToken
+ * в теле ответа заменяются псевдонимом - 32 шестнадцатеричными цифрами от SHA-256 соли и токена.
+ * Соль случайна для каждой записи, поэтому один токен в пределах файла получает один псевдоним,
+ * и воспроизведение сопоставляет игроков так же, как по настоящим токенам.
+ */
+
+struct RequestRecord {
+    std::uint64_t connection_id = 0;
+    std::uint64_t request_index = 0;
+    std::chrono::nanoseconds timestamp{0};
+    std::string method;
+    std::string target;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+};
+
+struct ResponseRecord {
+    std::uint64_t connection_id = 0;
+    std::uint64_t request_index = 0;
+    std::chrono::nanoseconds timestamp{0};
+    unsigned status = 0;
+    std::uint64_t body_hash = 0;
+    // Отсутствует, если тело было длиннее MAX_CAPTURED_BODY_SIZE или запись сделана версией 1
+    std::optional<std::string> body;
+};
+
+struct Capture {
+    std::vector<RequestRecord> requests;
+    std::vector<ResponseRecord> responses;
+};
+
+std::uint64_t HashBody(std::string_view body) noexcept;
+
+// Читает файл записи трафика. Выбрасывает std::runtime_error, если файл повреждён
+Capture ReadCapture(const std::filesystem::path& path);
+
+// Потокобезопасно записывает запросы и ответы в файл.
+// Записи копятся в буфере. Заполненный буфер передаётся отдельному потоку записи, поэтому
+// рабочие потоки сервера не ждут диска. Если диск не успевает, буферы сверх
+// MAX_PENDING_BUFFERS отбрасываются целиком, и число потерянных байт выводится при закрытии
+class TrafficRecorder {
+public:
+    explicit TrafficRecorder(const std::filesystem::path& path);
+
+    TrafficRecorder(const TrafficRecorder&) = delete;
+    TrafficRecorder& operator=(const TrafficRecorder&) = delete;
+
+    ~TrafficRecorder();
+
+    void RecordRequest(std::uint64_t connection_id, std::uint64_t request_index,
+                       const http::request<http::string_body>& request);
+    void RecordResponse(std::uint64_t connection_id, std::uint64_t request_index, unsigned status,
+                        std::string_view body);
+
+private:
+    std::chrono::nanoseconds GetTimestamp() const noexcept {
+        return std::chrono::steady_clock::now() - start_time_;
+    }
+
+    void Append(std::string_view data);
+    void Run(std::stop_token stop_token);
+    void WriteBuffer(std::string_view data);
+    std::string PseudonymizeToken(std::string_view token) const;
+    std::string RedactResponseBody(std::string_view body) const;
+
+    std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+    std::array<unsigned char, 16> token_salt_{};
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    // Заполняемый буфер и заполненные буферы, ожидающие записи
+    std::string buffer_;
+    std::vector<std::string> full_buffers_;
+    std::uint64_t dropped_bytes_ = 0;
+    int fd_ = -1;
+    std::jthread thread_;
+};
+
+}  // namespace traffic
@@ -0,0 +1,519 @@
+// Воспроизводит записанный сервером трафик (см. опцию --capture-file game_server)
+// и выводит распределение задержек и число ответов, отличающихся от записанных
+#include "sdk.h"
+//
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/json.hpp>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+#include "traffic_capture.h"
+
+using namespace std::literals;
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace json = boost::json;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr std::string_view JOIN_PATH = "/api/v1/game/join"sv;
+constexpr std::string_view PLAYERS_PATH = "/api/v1/game/players"sv;
+constexpr std::string_view BEARER_PREFIX = "Bearer "sv;
+
+// Ответы этих эндпоинтов зависят от порядка входа игроков и от времени,
+// поэтому у них сравнивается только статус
+constexpr std::array VOLATILE_PATHS{JOIN_PATH, "/api/v1/game/state"sv, "/api/v1/admin/trace"sv};
+
+struct Args {
+    std::string capture_file;
+    std::string host = "127.0.0.1"s;
+    std::string port = "8080"s;
+    // Во сколько раз ускорить воспроизведение. 0 - без пауз между запросами
+    double speed = 1.0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description desc{"Allowed options"s};
+
+    Args args;
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("capture-file", po::value(&args.capture_file)->value_name("file"s), "set captured traffic file path")
+        ("host", po::value(&args.host)->value_name("address"s), "set server address (127.0.0.1 by default)")
+        ("port", po::value(&args.port)->value_name("port"s), "set server port (8080 by default)")
+        ("speed", po::value(&args.speed)->value_name("factor"s),
+         "set replay speed factor: 1 - original pace, N - N times faster, 0 - as fast as possible")
+        ("threads", po::value(&args.threads)->value_name("n"s),
+         "set number of threads driving replayed connections (number of CPUs by default)");
+
+    po::positional_options_description positional;
+    positional.add("capture-file", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (vm.contains("help"s)) {
+        std::cout << "Usage: traffic_replay [options] <capture-file>"sv << std::endl << desc;
+        return std::nullopt;
+    }
+    if (!vm.contains("capture-file"s)) {
+        throw std::runtime_error("Capture file has not been specified");
+    }
+    if (args.speed < 0) {
+        throw std::runtime_error("Speed factor must not be negative");
+    }
+    if (args.threads == 0) {
+        throw std::runtime_error("Number of threads must be positive");
+    }
+    return args;
+}
+
+using ResponseKey = std::pair<std::uint64_t, std::uint64_t>;
+using Responses = std::map<ResponseKey, const traffic::ResponseRecord*>;
+
+struct Stats {
+    std::mutex mutex;
+    std::vector<Clock::duration> latencies;
+    std::atomic<std::uint64_t> errors{0};
+    std::atomic<std::uint64_t> mismatches{0};
+
+    void AddLatency(Clock::duration latency) {
+        std::lock_guard lock{mutex};
+        latencies.push_back(latency);
+    }
+};
+
+std::string_view GetTargetPath(std::string_view target) {
+    return target.substr(0, target.find('?'));
+}
+
+// Токен и id игрока из ответа на /game/join
+struct JoinResult {
+    std::string token;
+    std::string player_id;
+};
+
+std::optional<JoinResult> ParseJoinResult(std::string_view body) {
+    boost::system::error_code ec;
+    const json::value value = json::parse(body, ec);
+    if (ec || !value.is_object()) {
+        return std::nullopt;
+    }
+    const auto& obj = value.as_object();
+    const auto* token = obj.if_contains("authToken");
+    const auto* player_id = obj.if_contains("playerId");
+    if (!token || !token->is_string() || !player_id || !player_id->is_number()) {
+        return std::nullopt;
+    }
+    return JoinResult{std::string{token->as_string()}, json::serialize(*player_id)};
+}
+
+std::optional<JoinResult> GetCapturedJoin(const traffic::ResponseRecord* response) {
+    if (!response || response->status != static_cast<unsigned>(http::status::ok) || !response->body) {
+        return std::nullopt;
+    }
+    return ParseJoinResult(*response->body);
+}
+
+// Соответствие между игроками записанного трафика и игроками, вошедшими при воспроизведении.
+// Запрос с токеном из записи ждёт, пока будет воспроизведён вход выдавшего его игрока,
+// и отправляется с токеном, который сервер выдал при воспроизведении
+class PlayerMapping {
+public:
+    // Получает токен для запроса или std::nullopt, если токен из записи нужно оставить
+    using TokenHandler = std::function<void(std::optional<std::string> token)>;
+
+    // Регистрирует вход игрока из записи. Вызывается до начала воспроизведения
+    void Expect(const JoinResult& captured) {
+        tokens_.try_emplace(captured.token);
+    }
+
+    // Сообщает результат воспроизведения входа игрока captured.
+    // replayed = std::nullopt, если войти не удалось
+    void Resolve(const JoinResult& captured, const std::optional<JoinResult>& replayed) {
+        std::vector<TokenHandler> waiters;
+        std::optional<std::string> token;
+        {
+            std::lock_guard lock{mutex_};
+            const auto it = tokens_.find(captured.token);
+            if (it == tokens_.end() || it->second.resolved) {
+                return;
+            }
+            auto& entry = it->second;
+            entry.resolved = true;
+            if (replayed) {
+                entry.token = token = replayed->token;
+                player_ids_.emplace(captured.player_id, replayed->player_id);
+            }
+            waiters.swap(entry.waiters);
+        }
+        for (auto& waiter : waiters) {
+            waiter(token);
+        }
+    }
+
+    // Вызывает handler с токеном, заменяющим captured_token. Если вход игрока ещё
+    // не воспроизведён, handler будет вызван из Resolve в потоке, воспроизводящем вход
+    void AsyncGetToken(const std::string& captured_token, TokenHandler handler) {
+        std::unique_lock lock{mutex_};
+        const auto it = tokens_.find(captured_token);
+        if (it == tokens_.end()) {
+            lock.unlock();
+            return handler(std::nullopt);
+        }
+        if (!it->second.resolved) {
+            it->second.waiters.push_back(std::move(handler));
+            return;
+        }
+        auto token = it->second.token;
+        lock.unlock();
+        handler(std::move(token));
+    }
+
+    std::optional<std::string> FindPlayerId(const std::string& captured_id) const {
+        std::lock_guard lock{mutex_};
+        if (const auto it = player_ids_.find(captured_id); it != player_ids_.end()) {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+
+private:
+    struct Entry {
+        bool resolved = false;
+        // Токен, выданный при воспроизведении
+        std::optional<std::string> token;
+        std::vector<TokenHandler> waiters;
+    };
+
+    mutable std::mutex mutex_;
+    // Набор ключей заполняется до начала воспроизведения и больше не меняется
+    std::unordered_map<std::string, Entry> tokens_;
+    std::unordered_map<std::string, std::string> player_ids_;
+};
+
+// Сравнивает список игроков, заменяя id игроков из записи на id, выданные при воспроизведении
+bool PlayersMatch(std::string_view expected_body, std::string_view body, const PlayerMapping& mapping) {
+    boost::system::error_code ec;
+    const json::value expected = json::parse(expected_body, ec);
+    if (ec || !expected.is_object()) {
+        return expected_body == body;
+    }
+    const json::value actual = json::parse(body, ec);
+    if (ec || !actual.is_object()) {
+        return false;
+    }
+    json::object remapped;
+    for (const auto& player : expected.as_object()) {
+        const std::string captured_id{player.key()};
+        remapped[mapping.FindPlayerId(captured_id).value_or(captured_id)] = player.value();
+    }
+    return remapped == actual.as_object();
+}
+
+bool MatchesCapture(std::string_view path, const traffic::ResponseRecord& expected,
+                    const http::response<http::string_body>& response, const PlayerMapping& mapping) {
+    if (response.result_int() != expected.status) {
+        return false;
+    }
+    if (std::find(VOLATILE_PATHS.begin(), VOLATILE_PATHS.end(), path) != VOLATILE_PATHS.end()) {
+        return true;
+    }
+    if (path == PLAYERS_PATH) {
+        // Без тела из записи id игроков сопоставить нельзя
+        return !expected.body || PlayersMatch(*expected.body, response.body(), mapping);
+    }
+    return traffic::HashBody(response.body()) == expected.body_hash;
+}
+
+bool IsIdempotent(http::verb method) {
+    return method == http::verb::get || method == http::verb::head;
+}
+
+http::request<http::string_body> MakeRequest(const traffic::RequestRecord& record) {
+    http::request<http::string_body> request;
+    request.method_string(record.method);
+    request.target(record.target);
+    request.version(11);
+    for (const auto& [name, value] : record.headers) {
+        request.insert(name, value);
+    }
+    request.body() = record.body;
+    return request;
+}
+
+// Общие данные всех воспроизводимых соединений
+struct ReplayContext {
+    const Args& args;
+    tcp::resolver::results_type endpoints;
+    const Responses& responses;
+    Clock::time_point start;
+    std::chrono::nanoseconds first_timestamp;
+    Stats& stats;
+    PlayerMapping& mapping;
+};
+
+// Асинхронно воспроизводит запросы одного записанного соединения в отдельном соединении.
+// Все операции соединения выполняются на его strand
+class ConnectionReplay : public std::enable_shared_from_this<ConnectionReplay> {
+public:
+    using Strand = net::strand<net::io_context::executor_type>;
+
+    ConnectionReplay(Strand strand, const ReplayContext& context,
+                     const std::vector<const traffic::RequestRecord*>& requests)
+        : strand_{std::move(strand)}
+        , timer_{strand_}
+        , context_{context}
+        , requests_{requests} {
+    }
+
+    void Start() {
+        net::dispatch(strand_, [self = shared_from_this()] {
+            self->Next();
+        });
+    }
+
+private:
+    void Next() {
+        if (index_ == requests_.size()) {
+            stream_.reset();
+            return;
+        }
+        const auto& record = *requests_[index_];
+        if (context_.args.speed == 0) {
+            return Prepare();
+        }
+        const auto offset = std::chrono::duration_cast<Clock::duration>(
+            (record.timestamp - context_.first_timestamp) / context_.args.speed);
+        timer_.expires_at(context_.start + offset);
+        timer_.async_wait([self = shared_from_this()](beast::error_code) {
+            self->Prepare();
+        });
+    }
+
+    void Prepare() {
+        const auto& record = *requests_[index_];
+        request_ = MakeRequest(record);
+        path_ = GetTargetPath(record.target);
+        const auto it = context_.responses.find({record.connection_id, record.request_index});
+        expected_ = it != context_.responses.end() ? it->second : nullptr;
+        captured_join_ = path_ == JOIN_PATH ? GetCapturedJoin(expected_) : std::nullopt;
+        retried_ = false;
+
+        const std::string_view authorization = request_[http::field::authorization];
+        if (!authorization.starts_with(BEARER_PREFIX)) {
+            return Send();
+        }
+        context_.mapping.AsyncGetToken(
+            std::string{authorization.substr(BEARER_PREFIX.size())},
+            [self = shared_from_this()](std::optional<std::string> token) {
+                net::dispatch(self->strand_, [self, token = std::move(token)] {
+                    if (token) {
+                        self->request_.set(http::field::authorization, std::string{BEARER_PREFIX} + *token);
+                    }
+                    self->Send();
+                });
+            });
+    }
+
+    void Send() {
+        request_start_ = Clock::now();
+        if (stream_) {
+            return Write();
+        }
+        Connect();
+    }
+
+    void Connect() {
+        stream_.emplace(strand_);
+        buffer_.clear();
+        stream_->async_connect(context_.endpoints,
+                               [self = shared_from_this()](beast::error_code ec, const tcp::endpoint&) {
+                                   if (ec) {
+                                       return self->OnFailure(false);
+                                   }
+                                   self->Write();
+                               });
+    }
+
+    void Write() {
+        http::async_write(*stream_, request_, [self = shared_from_this()](beast::error_code ec, size_t) {
+            if (ec) {
+                // Запрос не передан целиком, сервер его не обработал
+                return self->OnFailure(false);
+            }
+            self->Read();
+        });
+    }
+
+    void Read() {
+        response_ = {};
+        http::async_read(*stream_, buffer_, response_, [self = shared_from_this()](beast::error_code ec, size_t) {
+            if (ec) {
+                return self->OnFailure(true);
+            }
+            self->OnResponse();
+        });
+    }
+
+    void OnFailure(bool may_be_processed) {
+        stream_.reset();
+        // Сервер мог закрыть соединение: в этом случае один раз переподключаемся.
+        // Неидемпотентный запрос, который сервер мог уже обработать, не повторяем
+        if (!retried_ && (!may_be_processed || IsIdempotent(request_.method()))) {
+            retried_ = true;
+            return Connect();
+        }
+        ++context_.stats.errors;
+        if (captured_join_) {
+            context_.mapping.Resolve(*captured_join_, std::nullopt);
+        }
+        ++index_;
+        Next();
+    }
+
+    void OnResponse() {
+        context_.stats.AddLatency(Clock::now() - request_start_);
+        if (captured_join_) {
+            context_.mapping.Resolve(*captured_join_, response_.result() == http::status::ok
+                                                          ? ParseJoinResult(response_.body())
+                                                          : std::nullopt);
+        }
+        if (expected_ && !MatchesCapture(path_, *expected_, response_, context_.mapping)) {
+            ++context_.stats.mismatches;
+        }
+        // После смены протокола соединение больше не используется для HTTP
+        if (response_.need_eof() || response_.result() == http::status::switching_protocols) {
+            stream_.reset();
+        }
+        ++index_;
+        Next();
+    }
+
+    Strand strand_;
+    net::steady_timer timer_;
+    const ReplayContext& context_;
+    const std::vector<const traffic::RequestRecord*>& requests_;
+    size_t index_ = 0;
+
+    std::optional<beast::tcp_stream> stream_;
+    beast::flat_buffer buffer_;
+    http::request<http::string_body> request_;
+    http::response<http::string_body> response_;
+    std::string path_;
+    const traffic::ResponseRecord* expected_ = nullptr;
+    std::optional<JoinResult> captured_join_;
+    Clock::time_point request_start_;
+    bool retried_ = false;
+};
+
+void PrintReport(Stats& stats, Clock::duration elapsed) {
+    using namespace std::chrono;
+    auto& latencies = stats.latencies;
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&latencies](double p) -> long long {
+        if (latencies.empty()) {
+            return 0;
+        }
+        const auto index = std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()));
+        return duration_cast<microseconds>(latencies[index]).count();
+    };
+
+    const double seconds = duration<double>(elapsed).count();
+    std::cout << "requests:   "sv << latencies.size() << std::endl;
+    std::cout << "errors:     "sv << stats.errors << std::endl;
+    std::cout << "mismatches: "sv << stats.mismatches << std::endl;
+    std::cout << "elapsed_s:  "sv << seconds << std::endl;
+    std::cout << "rps:        "sv << (seconds > 0 ? latencies.size() / seconds : 0) << std::endl;
+    std::cout << "latency_us: p50="sv << percentile(0.5) << " p90="sv << percentile(0.9)
+              << " p99="sv << percentile(0.99) << " p999="sv << percentile(0.999)
+              << " max="sv << (latencies.empty() ? 0 : duration_cast<microseconds>(latencies.back()).count())
+              << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    try {
+        auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+
+        const auto capture = traffic::ReadCapture(args->capture_file);
+        if (capture.requests.empty()) {
+            std::cout << "Capture is empty"sv << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        Responses responses;
+        for (const auto& response : capture.responses) {
+            responses.emplace(ResponseKey{response.connection_id, response.request_index}, &response);
+        }
+
+        // Группируем запросы по исходным соединениям, чтобы сохранить исходную конкурентность
+        std::map<std::uint64_t, std::vector<const traffic::RequestRecord*>> connections;
+        std::chrono::nanoseconds first_timestamp = capture.requests.front().timestamp;
+        PlayerMapping mapping;
+        for (const auto& request : capture.requests) {
+            connections[request.connection_id].push_back(&request);
+            first_timestamp = std::min(first_timestamp, request.timestamp);
+            if (GetTargetPath(request.target) == JOIN_PATH) {
+                const auto it = responses.find({request.connection_id, request.request_index});
+                if (const auto join = GetCapturedJoin(it != responses.end() ? it->second : nullptr)) {
+                    mapping.Expect(*join);
+                }
+            }
+        }
+
+        net::io_context ioc{static_cast<int>(args->threads)};
+        tcp::resolver resolver{ioc};
+
+        Stats stats;
+        const auto start = Clock::now();
+        const ReplayContext context{*args, resolver.resolve(args->host, args->port), responses, start,
+                                    first_timestamp, stats, mapping};
+        for (const auto& [connection_id, requests] : connections) {
+            std::make_shared<ConnectionReplay>(net::make_strand(ioc), context, requests)->Start();
+        }
+        {
+            // Соединения воспроизводятся асинхронно на ограниченном числе потоков
+            std::vector<std::jthread> workers;
+            workers.reserve(args->threads);
+            for (unsigned i = 0; i < args->threads; ++i) {
+                workers.emplace_back([&ioc] {
+                    ioc.run();
+                });
+            }
+        }
+        PrintReport(stats, Clock::now() - start);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}